@@ -0,0 +1,252 @@
+#ifndef STREAM_FRAMING_CPP
+#define STREAM_FRAMING_CPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+// Chunk framing shared by the container streams:
+//
+//     header chunk | data chunk ... data chunk | end chunk
+//     chunk:       bytes, records | payload | checksum of payload
+//     end chunk:   0, 0 | checksum over all previous chunk checksums
+//
+// Integers are stored in native byte order.
+
+// running checksum over 8 byte words, the result does not depend on how the data was split
+// between update calls
+class StreamChecksum
+{
+    uint64_t state = 0x243F6A8885A308D3ull;
+    unsigned char pending[8];
+    size_t pending_bytes = 0;
+    uint64_t total_bytes = 0;
+
+    static uint64_t mix(uint64_t state, uint64_t word);
+
+public:
+    void update(const void *data, size_t length);
+    uint64_t value() const;
+};
+
+inline uint64_t StreamChecksum::mix(uint64_t state, uint64_t word)
+{
+    state = (state ^ word) * 0x9FB21C651E98DF25ull;
+    return state ^ (state >> 32);
+}
+
+inline void StreamChecksum::update(const void *data, size_t length)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    total_bytes += length;
+
+    if (pending_bytes != 0)
+    {
+        size_t taken = std::min(length, sizeof(pending) - pending_bytes);
+        std::memcpy(pending + pending_bytes, bytes, taken);
+        pending_bytes += taken;
+        bytes += taken;
+        length -= taken;
+
+        if (pending_bytes < sizeof(pending))
+        {
+            return;
+        }
+
+        uint64_t word;
+        std::memcpy(&word, pending, sizeof(word));
+        state = mix(state, word);
+        pending_bytes = 0;
+    }
+
+    for (; length >= 8; bytes += 8, length -= 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        state = mix(state, word);
+    }
+
+    std::memcpy(pending, bytes, length);
+    pending_bytes = length;
+}
+
+inline uint64_t StreamChecksum::value() const
+{
+    uint64_t result = state;
+    if (pending_bytes != 0)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, pending, pending_bytes);
+        result = mix(result, word);
+    }
+    return mix(result, total_bytes);
+}
+
+struct StreamChunk
+{
+    uint32_t bytes, records;
+};
+
+class StreamWriter
+{
+    std::ostream &out;
+    StreamChecksum chunk_sum, total_sum;
+
+public:
+    static constexpr size_t default_chunk_bytes = 1 << 16;
+    static constexpr size_t max_chunk_bytes = size_t(1) << 30;
+
+    explicit StreamWriter(std::ostream &target);
+
+    // payload of a chunk is passed in any number of write calls between begin and end
+    void begin_chunk(size_t bytes, size_t records);
+    void write(const void *data, size_t length);
+    void end_chunk();
+
+    void write_chunk(const void *data, size_t bytes, size_t records);
+
+    // writes the end chunk and flushes, throws when the target failed anywhere on the way
+    void finish();
+};
+
+inline StreamWriter::StreamWriter(std::ostream &target) : out(target)
+{
+}
+
+inline void StreamWriter::begin_chunk(size_t bytes, size_t records)
+{
+    StreamChunk chunk{static_cast<uint32_t>(bytes), static_cast<uint32_t>(records)};
+    out.write(reinterpret_cast<const char *>(&chunk), sizeof(chunk));
+}
+
+inline void StreamWriter::write(const void *data, size_t length)
+{
+    chunk_sum.update(data, length);
+    out.write(static_cast<const char *>(data), static_cast<std::streamsize>(length));
+}
+
+inline void StreamWriter::end_chunk()
+{
+    uint64_t checksum = chunk_sum.value();
+    out.write(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+    total_sum.update(&checksum, sizeof(checksum));
+    chunk_sum = StreamChecksum();
+}
+
+inline void StreamWriter::write_chunk(const void *data, size_t bytes, size_t records)
+{
+    begin_chunk(bytes, records);
+    write(data, bytes);
+    end_chunk();
+}
+
+inline void StreamWriter::finish()
+{
+    begin_chunk(0, 0);
+    uint64_t checksum = total_sum.value();
+    out.write(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+    out.flush();
+    if (!out)
+    {
+        throw std::runtime_error("Cannot write stream");
+    }
+}
+
+class StreamReader
+{
+    std::istream &in;
+    StreamChecksum chunk_sum, total_sum;
+    uint64_t chunk_bytes = 0, chunk_read = 0;
+
+public:
+    // a size from a header is not verified by anything, readers allocate at most this much
+    // ahead of the data on its word and grow with the chunks from there
+    static constexpr size_t max_reserve_bytes = size_t(1) << 24;
+
+    explicit StreamReader(std::istream &source);
+
+    // returns the record count of the next chunk, zero for the end chunk, throws unless the
+    // payload is exactly records * record_size bytes and no longer than a writer ever makes it
+    size_t begin_chunk(size_t record_size);
+    void read(void *data, size_t length);
+    void end_chunk();
+
+    void read_chunk(void *data, size_t bytes);
+
+    // consumes the end chunk and checks it against every chunk seen so far
+    void finish();
+};
+
+inline StreamReader::StreamReader(std::istream &source) : in(source)
+{
+}
+
+inline size_t StreamReader::begin_chunk(size_t record_size)
+{
+    StreamChunk chunk;
+    if (!in.read(reinterpret_cast<char *>(&chunk), sizeof(chunk)))
+    {
+        throw std::runtime_error("Stream is truncated");
+    }
+    if (uint64_t(chunk.records) * record_size != chunk.bytes || chunk.bytes > StreamWriter::max_chunk_bytes)
+    {
+        throw std::runtime_error("Stream chunk is corrupted");
+    }
+
+    chunk_bytes = chunk.bytes;
+    chunk_read = 0;
+    return chunk.records;
+}
+
+inline void StreamReader::read(void *data, size_t length)
+{
+    if (chunk_read + length > chunk_bytes || !in.read(static_cast<char *>(data), static_cast<std::streamsize>(length)))
+    {
+        throw std::runtime_error("Stream is truncated");
+    }
+    chunk_read += length;
+    chunk_sum.update(data, length);
+}
+
+inline void StreamReader::end_chunk()
+{
+    uint64_t checksum;
+    if (chunk_read != chunk_bytes || !in.read(reinterpret_cast<char *>(&checksum), sizeof(checksum)))
+    {
+        throw std::runtime_error("Stream is truncated");
+    }
+    if (checksum != chunk_sum.value())
+    {
+        throw std::runtime_error("Stream checksum mismatch");
+    }
+    total_sum.update(&checksum, sizeof(checksum));
+    chunk_sum = StreamChecksum();
+}
+
+inline void StreamReader::read_chunk(void *data, size_t bytes)
+{
+    if (begin_chunk(bytes) != 1)
+    {
+        throw std::runtime_error("Stream chunk is corrupted");
+    }
+    read(data, bytes);
+    end_chunk();
+}
+
+inline void StreamReader::finish()
+{
+    uint64_t checksum;
+    if (!in.read(reinterpret_cast<char *>(&checksum), sizeof(checksum)))
+    {
+        throw std::runtime_error("Stream is truncated");
+    }
+    if (checksum != total_sum.value())
+    {
+        throw std::runtime_error("Stream checksum mismatch");
+    }
+}
+
+#endif // STREAM_FRAMING_CPP
@@ -1,9 +1,28 @@
+#ifndef DEQUE_CPP
+#define DEQUE_CPP
+
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
-#include <iostream>
+#include <iterator>
 #include <type_traits>
+#include <utility>
+
+// rows hold about deque_row_bytes worth of values, at least 16 and a power of two
+constexpr size_t deque_row_bytes = 512;
 
 template <typename ValType>
+constexpr size_t default_row_length()
+{
+    size_t length = 16;
+    while (2 * length * sizeof(ValType) <= deque_row_bytes)
+    {
+        length *= 2;
+    }
+    return length;
+}
+
+template <typename ValType, size_t RowLength = default_row_length<ValType>()>
 class Deque
 {
     ValType **rows = nullptr;
@@ -11,17 +30,39 @@ class Deque
     size_t row_cap = 0;
     size_t base_row_ind = 0;
     size_t zero_ind = 0;
-    static const size_t row_length = 32;
+    static constexpr size_t row_length = RowLength;
+    static_assert(row_length != 0, "rows hold at least one value");
+
+    // positions split into a row and a slot in that row, by shift and mask for power of two lengths
+    static constexpr bool row_length_pow2 = (row_length & (row_length - 1)) == 0;
+    static constexpr size_t row_shift();
+    static size_t row_of(size_t position);
+    static size_t in_row(size_t position);
+
+    // rows given back by pops, reused before anything new is allocated
+    static const size_t max_free_rows = 4;
+    ValType *free_rows[max_free_rows] = {};
+    size_t free_row_cnt = 0;
+
+    // streaming reads and writes go through whole rows
+    template <typename T, size_t Length>
+    friend class DequeStream;
 
 public:
     // constructors
     Deque();
     Deque(int cap, const ValType &elem = ValType());
-    Deque(const Deque<ValType> &other);
-    Deque &operator=(const Deque<ValType> &other);
+    Deque(const Deque<ValType, RowLength> &other);
+    Deque(Deque<ValType, RowLength> &&other) noexcept;
+    Deque &operator=(const Deque<ValType, RowLength> &other);
+    Deque &operator=(Deque<ValType, RowLength> &&other) noexcept;
+    ~Deque();
 
-    // memory allocation
+    void swap(Deque<ValType, RowLength> &other) noexcept;
+
+    // memory allocation, rows themselves are allocated once an element goes into them
     void reserve_rows(size_t amount);
+    void shrink_to_fit();
 
     // indexation
     size_t size() const;
@@ -32,9 +73,15 @@ public:
 
     // element insertion/deletion
     void push_back(const ValType &value);
+    void push_back(ValType &&value);
+    template <typename... Args>
+    ValType &emplace_back(Args &&...args);
     void pop_back();
 
     void push_front(const ValType &value);
+    void push_front(ValType &&value);
+    template <typename... Args>
+    ValType &emplace_front(Args &&...args);
     void pop_front();
 
     // iterators
@@ -63,94 +110,129 @@ public:
     reverse_iterator rend();
     const_reverse_iterator rend() const;
 
-    // insertion and deletion
-    void insert(iterator ins_iter, const ValType &ins_value);
-    void erase(iterator ers_iter);
+    // insertion and deletion, only the elements between the position and the nearer end move
+    iterator insert(const_iterator ins_iter, const ValType &ins_value);
+    iterator insert(const_iterator ins_iter, size_t count, const ValType &ins_value);
+    template <typename InputIt, typename = std::enable_if_t<!std::is_integral<InputIt>::value>>
+    iterator insert(const_iterator ins_iter, InputIt first, InputIt last);
+
+    iterator erase(const_iterator ers_iter);
+    iterator erase(const_iterator first, const_iterator last);
+
+private:
+    // destroys the elements and frees every row
+    void release();
+
+    // rows array of new_cap slots with the used rows in the middle, every other row is released
+    void relocate_rows(size_t new_cap);
+    size_t used_rows() const;
+
+    ValType *acquire_row();
+    void release_row(size_t row);
+    // allocates the missing rows of positions [from, to)
+    void allocate_rows(size_t from, size_t to);
+    // releases the rows of the vacated positions [from, to) that hold no element any more
+    void release_rows(size_t from, size_t to);
+
+    // positions count slots from the start of rows[0]
+    size_t head() const;
+    void set_head(size_t position);
+    ValType *slot(size_t position) const;
+    void destroy_slots(size_t position, size_t amount);
+
+    // makes sure amount free slots are allocated before the first or after the last element
+    void reserve_front(size_t amount);
+    void reserve_back(size_t amount);
+    void make_room(size_t amount);
+
+    // opens count slots at index by shifting the nearer end and fills them with next()
+    template <typename Source>
+    iterator insert_shifted(size_t index, size_t count, Source &&next);
 };
 
 // iterator initialization
-template <typename ValType>
-typename Deque<ValType>::const_reverse_iterator Deque<ValType>::crbegin() const
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::const_reverse_iterator Deque<ValType, RowLength>::crbegin() const
 {
-    return const_reverse_iterator((int)sz - 1, *this);
+    return const_reverse_iterator(cend());
 };
 
-template <typename ValType>
-typename Deque<ValType>::const_reverse_iterator Deque<ValType>::crend() const
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::const_reverse_iterator Deque<ValType, RowLength>::crend() const
 {
-    return const_reverse_iterator(-1, *this);
+    return const_reverse_iterator(cbegin());
 };
 
-template <typename ValType>
-typename Deque<ValType>::reverse_iterator Deque<ValType>::rbegin()
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::reverse_iterator Deque<ValType, RowLength>::rbegin()
 {
-    return reverse_iterator((int)sz - 1, *this);
+    return reverse_iterator(end());
 };
 
-template <typename ValType>
-typename Deque<ValType>::const_reverse_iterator Deque<ValType>::rbegin() const
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::const_reverse_iterator Deque<ValType, RowLength>::rbegin() const
 {
     return crbegin();
 };
 
-template <typename ValType>
-typename Deque<ValType>::reverse_iterator Deque<ValType>::rend()
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::reverse_iterator Deque<ValType, RowLength>::rend()
 {
-    return reverse_iterator(-1, *this);
+    return reverse_iterator(begin());
 };
 
-template <typename ValType>
-typename Deque<ValType>::const_reverse_iterator Deque<ValType>::rend() const
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::const_reverse_iterator Deque<ValType, RowLength>::rend() const
 {
     return crend();
 };
 
-template <typename ValType>
-typename Deque<ValType>::const_iterator Deque<ValType>::cbegin() const
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::const_iterator Deque<ValType, RowLength>::cbegin() const
 {
     return const_iterator(0, *this);
 };
 
-template <typename ValType>
-typename Deque<ValType>::const_iterator Deque<ValType>::cend() const
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::const_iterator Deque<ValType, RowLength>::cend() const
 {
     return const_iterator(sz, *this);
 };
 
-template <typename ValType>
-typename Deque<ValType>::iterator Deque<ValType>::begin()
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::iterator Deque<ValType, RowLength>::begin()
 {
     return iterator(0, *this);
 };
 
-template <typename ValType>
-typename Deque<ValType>::const_iterator Deque<ValType>::begin() const
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::const_iterator Deque<ValType, RowLength>::begin() const
 {
     return cbegin();
 };
 
-template <typename ValType>
-typename Deque<ValType>::iterator Deque<ValType>::end()
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::iterator Deque<ValType, RowLength>::end()
 {
     return iterator(sz, *this);
 };
 
-template <typename ValType>
-typename Deque<ValType>::const_iterator Deque<ValType>::end() const
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::const_iterator Deque<ValType, RowLength>::end() const
 {
     return cend();
 };
 
 // constructors
 
-template <typename ValType>
-Deque<ValType>::Deque()
+template <typename ValType, size_t RowLength>
+Deque<ValType, RowLength>::Deque()
 {
     reserve_rows(1);
 }
 
-template <typename ValType>
-Deque<ValType>::Deque(int cap, const ValType &value)
+template <typename ValType, size_t RowLength>
+Deque<ValType, RowLength>::Deque(int cap, const ValType &value)
 {
     reserve_rows(1);
     for (int i = 0; i < cap; i++)
@@ -159,93 +241,174 @@ Deque<ValType>::Deque(int cap, const ValType &value)
     }
 }
 
-template <typename ValType>
-Deque<ValType>::Deque(const Deque<ValType> &other)
+template <typename ValType, size_t RowLength>
+Deque<ValType, RowLength>::Deque(const Deque<ValType, RowLength> &other)
 {
     reserve_rows(other.row_cap);
     auto other_beg_iter = other.begin();
     // can throw exception
-    int elem_cop = 0;
     try
     {
         while (other_beg_iter != other.end())
         {
             push_back(*other_beg_iter);
             ++other_beg_iter;
-            ++elem_cop;
         }
     }
     catch (...)
     {
-        while (elem_cop--)
-        {
-            pop_back();
-        }
+        release();
         throw;
     }
 }
 
-// I am not sure
-template <typename ValType>
-Deque<ValType> &Deque<ValType>::operator=(const Deque<ValType> &other)
+// the moved-from deque owns no rows, its next push allocates them again
+template <typename ValType, size_t RowLength>
+Deque<ValType, RowLength>::Deque(Deque<ValType, RowLength> &&other) noexcept
+    : rows(other.rows), sz(other.sz), row_cap(other.row_cap), base_row_ind(other.base_row_ind), zero_ind(other.zero_ind),
+      free_row_cnt(other.free_row_cnt)
 {
-    int elem_copied = 0;
-    size_t init_sz = size();
-    try
+    std::copy(other.free_rows, other.free_rows + other.free_row_cnt, free_rows);
+    other.free_row_cnt = 0;
+    other.rows = nullptr;
+    other.sz = 0;
+    other.row_cap = 0;
+    other.base_row_ind = 0;
+    other.zero_ind = 0;
+}
+
+template <typename ValType, size_t RowLength>
+Deque<ValType, RowLength> &Deque<ValType, RowLength>::operator=(const Deque<ValType, RowLength> &other)
+{
+    if (this == &other)
     {
-        auto other_iter = other.begin();
-        while (other_iter != other.end())
-        {
-            push_back(*other_iter);
-            ++other_iter;
-            ++elem_copied;
-        }
-        for (size_t i = 0; i < init_sz; i++)
-        {
-            pop_front();
-        }
-        return (*this);
+        return *this;
     }
-    catch (...)
+
+    Deque<ValType, RowLength> copy(other);
+    swap(copy);
+    return *this;
+}
+
+template <typename ValType, size_t RowLength>
+Deque<ValType, RowLength> &Deque<ValType, RowLength>::operator=(Deque<ValType, RowLength> &&other) noexcept
+{
+    if (this == &other)
     {
-        while (elem_copied--)
-        {
-            pop_back();
-        }
-        return (*this);
-        throw;
+        return *this;
+    }
+
+    Deque<ValType, RowLength> copy(std::move(other));
+    swap(copy);
+    return *this;
+}
+
+template <typename ValType, size_t RowLength>
+Deque<ValType, RowLength>::~Deque()
+{
+    release();
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::release()
+{
+    destroy_slots(head(), sz);
+    for (size_t i = 0; i < row_cap; i++)
+    {
+        delete[] reinterpret_cast<int8_t *>(rows[i]);
     }
+    delete[] rows;
+    while (free_row_cnt != 0)
+    {
+        delete[] reinterpret_cast<int8_t *>(free_rows[--free_row_cnt]);
+    }
+
+    rows = nullptr;
+    sz = 0;
+    row_cap = 0;
+    base_row_ind = 0;
+    zero_ind = 0;
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::swap(Deque<ValType, RowLength> &other) noexcept
+{
+    std::swap(rows, other.rows);
+    std::swap(sz, other.sz);
+    std::swap(row_cap, other.row_cap);
+    std::swap(base_row_ind, other.base_row_ind);
+    std::swap(zero_ind, other.zero_ind);
+    std::swap(free_rows, other.free_rows);
+    std::swap(free_row_cnt, other.free_row_cnt);
 }
 
 // self-info
-template <typename ValType>
-size_t Deque<ValType>::size() const
+template <typename ValType, size_t RowLength>
+size_t Deque<ValType, RowLength>::size() const
 {
     return sz;
 }
 
+// index math
+template <typename ValType, size_t RowLength>
+constexpr size_t Deque<ValType, RowLength>::row_shift()
+{
+    size_t shift = 0;
+    while ((size_t(1) << shift) < row_length)
+    {
+        ++shift;
+    }
+    return shift;
+}
+
+template <typename ValType, size_t RowLength>
+size_t Deque<ValType, RowLength>::row_of(size_t position)
+{
+    if constexpr (row_length_pow2)
+    {
+        return position >> row_shift();
+    }
+    else
+    {
+        return position / row_length;
+    }
+}
+
+template <typename ValType, size_t RowLength>
+size_t Deque<ValType, RowLength>::in_row(size_t position)
+{
+    if constexpr (row_length_pow2)
+    {
+        return position & (row_length - 1);
+    }
+    else
+    {
+        return position % row_length;
+    }
+}
+
 // indexation
-template <typename ValType>
-const ValType &Deque<ValType>::operator[](size_t index_need) const
+template <typename ValType, size_t RowLength>
+const ValType &Deque<ValType, RowLength>::operator[](size_t index_need) const
 {
     size_t index = index_need + zero_ind;
-    return rows[base_row_ind + (index / row_length)][(index % row_length)];
+    return rows[base_row_ind + row_of(index)][in_row(index)];
 }
 
-template <typename ValType>
-ValType &Deque<ValType>::operator[](size_t index_need)
+template <typename ValType, size_t RowLength>
+ValType &Deque<ValType, RowLength>::operator[](size_t index_need)
 {
     size_t index = index_need + zero_ind;
-    return rows[base_row_ind + (index / row_length)][(index % row_length)];
+    return rows[base_row_ind + row_of(index)][in_row(index)];
 }
 
-template <typename ValType>
-const ValType &Deque<ValType>::at(size_t index_need) const
+template <typename ValType, size_t RowLength>
+const ValType &Deque<ValType, RowLength>::at(size_t index_need) const
 {
     size_t index = index_need + zero_ind;
     if (index_need < sz)
     {
-        return (rows[base_row_ind + (index / row_length)])[(index % row_length)];
+        return (rows[base_row_ind + row_of(index)])[in_row(index)];
     }
     else
     {
@@ -253,368 +416,655 @@ const ValType &Deque<ValType>::at(size_t index_need) const
     }
 }
 
-template <typename ValType>
-ValType &Deque<ValType>::at(size_t index_need)
+template <typename ValType, size_t RowLength>
+ValType &Deque<ValType, RowLength>::at(size_t index_need)
 {
     size_t index = index_need + zero_ind;
     if (index_need < sz)
     {
-        return (rows[base_row_ind + (index / row_length)])[(index % row_length)];
+        return (rows[base_row_ind + row_of(index)])[in_row(index)];
     }
     else
     {
         throw std::out_of_range("Index out of range!");
     }
-    return rows[base_row_ind][zero_ind];
 }
 
 // memory allocation
-template <typename ValType>
-void Deque<ValType>::reserve_rows(size_t amount)
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::reserve_rows(size_t amount)
 {
     if (row_cap > amount)
     {
         return;
     }
 
-    ValType **new_rows = new ValType *[amount];
-
-    size_t row_am = ((zero_ind + sz + row_length - 1) / row_length);
-    size_t new_base_ind = (amount - row_am) / 2;
+    relocate_rows(amount);
+}
 
-    for (size_t i = 0; i < new_base_ind; i++)
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::shrink_to_fit()
+{
+    relocate_rows(used_rows());
+    while (free_row_cnt != 0)
     {
-        new_rows[i] = reinterpret_cast<ValType *>(new int8_t[sizeof(ValType) * row_length]);
+        delete[] reinterpret_cast<int8_t *>(free_rows[--free_row_cnt]);
     }
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::relocate_rows(size_t new_cap)
+{
+    ValType **new_rows = new ValType *[new_cap]();
+
+    size_t row_am = used_rows();
+    size_t new_base_ind = (new_cap - row_am) / 2;
 
     for (size_t i = 0; i < row_am; i++)
     {
         new_rows[new_base_ind + i] = rows[base_row_ind + i];
+        rows[base_row_ind + i] = nullptr;
     }
 
-    for (size_t i = new_base_ind + row_am; i < amount; i++)
+    for (size_t i = 0; i < row_cap; i++)
     {
-        new_rows[i] = reinterpret_cast<ValType *>(new int8_t[sizeof(ValType) * row_length]);
+        release_row(i);
     }
 
     delete[] rows;
     rows = new_rows;
 
-    row_cap = amount;
+    row_cap = new_cap;
     base_row_ind = new_base_ind;
+    if (sz == 0)
+    {
+        zero_ind = 0;
+    }
 }
 
-// element insertion/deletion
-template <typename ValType>
-void Deque<ValType>::push_back(const ValType &value)
+template <typename ValType, size_t RowLength>
+size_t Deque<ValType, RowLength>::used_rows() const
 {
-    size_t ins_row = (zero_ind + sz) / row_length;
-    size_t ins_ind = (zero_ind + sz) % row_length;
+    return sz == 0 ? 0 : row_of(zero_ind + sz + row_length - 1);
+}
 
-    if (base_row_ind + ins_row == row_cap)
+template <typename ValType, size_t RowLength>
+ValType *Deque<ValType, RowLength>::acquire_row()
+{
+    if (free_row_cnt != 0)
     {
-        reserve_rows(2 * row_cap);
+        return free_rows[--free_row_cnt];
     }
+    return reinterpret_cast<ValType *>(new int8_t[sizeof(ValType) * row_length]);
+}
 
-    try
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::release_row(size_t row)
+{
+    ValType *released = rows[row];
+    if (released == nullptr)
     {
-        new (rows[base_row_ind + ins_row] + ins_ind) ValType(value);
-        ++sz;
+        return;
     }
-    catch (...)
+
+    rows[row] = nullptr;
+    if (free_row_cnt < max_free_rows)
     {
-        std::cerr << "caught someth! \n";
+        free_rows[free_row_cnt++] = released;
+    }
+    else
+    {
+        delete[] reinterpret_cast<int8_t *>(released);
     }
 }
 
-template <typename ValType>
-void Deque<ValType>::pop_back()
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::allocate_rows(size_t from, size_t to)
 {
-    size_t ins_row = (zero_ind + sz) / row_length;
-    size_t ins_ind = (zero_ind + sz) % row_length;
+    if (from == to)
+    {
+        return;
+    }
 
-    (rows[base_row_ind + ins_row] + ins_ind)->~ValType();
-    --sz;
+    for (size_t row = row_of(from); row <= row_of(to - 1); row++)
+    {
+        if (rows[row] == nullptr)
+        {
+            rows[row] = acquire_row();
+        }
+    }
 }
 
-template <typename ValType>
-void Deque<ValType>::push_front(const ValType &value)
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::release_rows(size_t from, size_t to)
 {
+    if (from == to)
+    {
+        return;
+    }
 
-    if (zero_ind == 0)
+    size_t live_first = row_of(head());
+    size_t live_last = live_first + used_rows();
+    for (size_t row = row_of(from); row <= row_of(to - 1); row++)
     {
-        if (base_row_ind == 0)
+        if (row < live_first || row >= live_last)
         {
-            reserve_rows(2 * row_cap + 1);
+            release_row(row);
         }
-
-        --base_row_ind;
-        zero_ind = row_length - 1;
     }
-    else
+}
+
+// element insertion/deletion
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::push_back(const ValType &value)
+{
+    emplace_back(value);
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::push_back(ValType &&value)
+{
+    emplace_back(std::move(value));
+}
+
+template <typename ValType, size_t RowLength>
+template <typename... Args>
+ValType &Deque<ValType, RowLength>::emplace_back(Args &&...args)
+{
+    reserve_back(1);
+
+    ValType *place = slot(head() + sz);
+    new (place) ValType(std::forward<Args>(args)...);
+    ++sz;
+    return *place;
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::pop_back()
+{
+    --sz;
+    size_t position = head() + sz;
+    slot(position)->~ValType();
+    release_rows(position, position + 1);
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::push_front(const ValType &value)
+{
+    emplace_front(value);
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::push_front(ValType &&value)
+{
+    emplace_front(std::move(value));
+}
+
+template <typename ValType, size_t RowLength>
+template <typename... Args>
+ValType &Deque<ValType, RowLength>::emplace_front(Args &&...args)
+{
+    reserve_front(1);
+
+    size_t new_first = head() - 1;
+    ValType *place = slot(new_first);
+    new (place) ValType(std::forward<Args>(args)...);
+    set_head(new_first);
+    ++sz;
+    return *place;
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::pop_front()
+{
+    size_t position = head();
+    slot(position)->~ValType();
+    --sz;
+    set_head(position + 1);
+    release_rows(position, position + 1);
+}
+
+// slot helpers
+template <typename ValType, size_t RowLength>
+size_t Deque<ValType, RowLength>::head() const
+{
+    return base_row_ind * row_length + zero_ind;
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::set_head(size_t position)
+{
+    base_row_ind = row_of(position);
+    zero_ind = in_row(position);
+}
+
+template <typename ValType, size_t RowLength>
+ValType *Deque<ValType, RowLength>::slot(size_t position) const
+{
+    return rows[row_of(position)] + in_row(position);
+}
+
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::destroy_slots(size_t position, size_t amount)
+{
+    for (size_t i = 0; i < amount; i++)
     {
-        --zero_ind;
+        slot(position + i)->~ValType();
     }
+}
 
-    new (rows[base_row_ind] + zero_ind) ValType(value);
-    ++sz;
+// relocate_rows centers the used rows, so leaving extra_rows free on both sides is enough for either end.
+// A deque used as a queue drifts towards one end, the rows array only doubles when it is at least half full.
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::make_room(size_t amount)
+{
+    size_t extra_rows = (amount + row_length - 1) / row_length;
+    size_t needed = used_rows() + 2 * extra_rows + 1;
+    relocate_rows(needed <= row_cap / 2 ? row_cap : std::max(2 * row_cap, needed));
 }
 
-template <typename ValType>
-void Deque<ValType>::pop_front()
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::reserve_front(size_t amount)
 {
-    if (zero_ind == row_length - 1)
+    if (head() < amount)
     {
-        if (base_row_ind == row_cap - 1)
-        {
-            reserve_rows(2 * row_cap);
-        }
+        make_room(amount);
     }
 
-    (rows[base_row_ind] + zero_ind)->~ValType();
-    --sz;
+    allocate_rows(head() - amount, head());
+}
 
-    ++zero_ind;
-    if (zero_ind == row_length)
+template <typename ValType, size_t RowLength>
+void Deque<ValType, RowLength>::reserve_back(size_t amount)
+{
+    if (row_cap * row_length - head() - sz < amount)
     {
-        zero_ind = 0;
-        ++base_row_ind;
+        make_room(amount);
     }
+
+    allocate_rows(head() + sz, head() + sz + amount);
 }
 
 // iter insert and erase
-template <typename ValType>
-void Deque<ValType>::erase(Deque<ValType>::iterator iter)
+// The elements on the shorter side of index move count slots outwards. The outermost of them are
+// move-constructed into the free slots past the end, the rest are move-assigned, and the values
+// land in the opened gap. If anything throws, the slots past the end are destroyed again and the
+// size stays the same, the shifted elements may be left moved-from.
+template <typename ValType, size_t RowLength>
+template <typename Source>
+typename Deque<ValType, RowLength>::iterator Deque<ValType, RowLength>::insert_shifted(size_t index, size_t count, Source &&next)
 {
-    Deque<ValType> res_copy;
+    if (count == 0)
+    {
+        return begin() + index;
+    }
 
-    try
+    size_t after = sz - index;
+    if (index < after)
     {
-        auto beg_iter = begin();
-        for (; beg_iter != iter; ++beg_iter)
+        reserve_front(count);
+
+        size_t new_first = head() - count;
+        iterator new_begin = begin() - count;
+        size_t moved_raw = std::min(index, count);
+        size_t built = 0;
+        try
         {
-            res_copy.push_back(*beg_iter);
+            for (; built < moved_raw; ++built)
+            {
+                new (slot(new_first + built)) ValType(std::move(*slot(new_first + count + built)));
+            }
+            for (; built < count; ++built)
+            {
+                new (slot(new_first + built)) ValType(next());
+            }
+            if (index > count)
+            {
+                std::move(new_begin + 2 * count, new_begin + index + count, new_begin + count);
+            }
+            for (size_t i = std::max(index, count); i < index + count; i++)
+            {
+                *slot(new_first + i) = next();
+            }
         }
-        ++beg_iter;
-        for (; beg_iter != end(); ++beg_iter)
+        catch (...)
         {
-            res_copy.push_back(*beg_iter);
+            destroy_slots(new_first, built);
+            throw;
         }
-        *this = res_copy;
+
+        set_head(new_first);
     }
-    catch (...)
+    else
     {
-        throw;
+        reserve_back(count);
+
+        size_t end_pos = head() + sz;
+        size_t moved_raw = std::min(after, count);
+        size_t moved = 0, built = 0;
+        try
+        {
+            for (; moved < moved_raw; ++moved)
+            {
+                new (slot(end_pos + count - moved_raw + moved)) ValType(std::move(*slot(end_pos - moved_raw + moved)));
+            }
+            std::move_backward(begin() + index, begin() + (sz - moved_raw), begin() + sz);
+            for (size_t i = 0; i < moved_raw; i++)
+            {
+                *slot(end_pos - after + i) = next();
+            }
+            for (; built < count - moved_raw; ++built)
+            {
+                new (slot(end_pos + built)) ValType(next());
+            }
+        }
+        catch (...)
+        {
+            destroy_slots(end_pos, built);
+            destroy_slots(end_pos + count - moved_raw, moved);
+            throw;
+        }
     }
+
+    sz += count;
+    return begin() + index;
 }
 
-template <typename ValType>
-void Deque<ValType>::insert(Deque<ValType>::iterator iter, const ValType &value)
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::iterator Deque<ValType, RowLength>::insert(const_iterator ins_iter, const ValType &ins_value)
 {
-    Deque<ValType> res_copy;
+    return insert(ins_iter, 1, ins_value);
+}
 
-    try
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::iterator Deque<ValType, RowLength>::insert(const_iterator ins_iter, size_t count, const ValType &ins_value)
+{
+    size_t index = ins_iter - cbegin();
+    // the value may be an element of this deque that the shift moves away
+    ValType copy(ins_value);
+    return insert_shifted(index, count, [&copy]() -> const ValType & { return copy; });
+}
+
+template <typename ValType, size_t RowLength>
+template <typename InputIt, typename>
+typename Deque<ValType, RowLength>::iterator Deque<ValType, RowLength>::insert(const_iterator ins_iter, InputIt first, InputIt last)
+{
+    using Category = typename std::iterator_traits<InputIt>::iterator_category;
+    size_t index = ins_iter - cbegin();
+
+    if constexpr (std::is_convertible<Category, std::forward_iterator_tag>::value)
     {
-        for (auto beg_iter = begin(); beg_iter != iter; ++beg_iter)
-        {
-            res_copy.push_back(*beg_iter);
-        }
-        res_copy.push_back(value);
-        Deque<ValType>::iterator end_iter(res_copy.size() - 1, *this);
-        for (; end_iter != end(); ++end_iter)
-        {
-            res_copy.push_back(*end_iter);
-        }
-        *this = res_copy;
+        size_t count = static_cast<size_t>(std::distance(first, last));
+        return insert_shifted(index, count, [&first]() -> decltype(auto) { return *first++; });
     }
-    catch (...)
+    else
     {
-        throw;
+        // single pass ranges are buffered first, so the elements still shift only once
+        std::vector<ValType> buffer(first, last);
+        auto buffer_iter = buffer.begin();
+        return insert_shifted(index, buffer.size(), [&buffer_iter]() -> ValType && { return std::move(*buffer_iter++); });
     }
 }
 
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::iterator Deque<ValType, RowLength>::erase(const_iterator ers_iter)
+{
+    return erase(ers_iter, ers_iter + 1);
+}
+
+template <typename ValType, size_t RowLength>
+typename Deque<ValType, RowLength>::iterator Deque<ValType, RowLength>::erase(const_iterator first, const_iterator last)
+{
+    size_t index = first - cbegin();
+    size_t count = last - first;
+    if (count == 0)
+    {
+        return begin() + index;
+    }
+
+    size_t vacated = head();
+    if (index < sz - index - count)
+    {
+        std::move_backward(begin(), begin() + index, begin() + (index + count));
+        destroy_slots(vacated, count);
+        set_head(vacated + count);
+    }
+    else
+    {
+        std::move(begin() + (index + count), end(), begin() + index);
+        vacated += sz - count;
+        destroy_slots(vacated, count);
+    }
+
+    sz -= count;
+    release_rows(vacated, vacated + count);
+    return begin() + index;
+}
+
 // iterator
-template <typename ValType>
+// position counts slots from the start of rows[0], so moving is plain integer arithmetic and
+// dereferencing is one shift and one mask away from the element
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-class Deque<ValType>::common_iterator
+class Deque<ValType, RowLength>::common_iterator
 {
-    size_t row_ind;
-    size_t in_row_ind;
-    std::conditional_t<IsConst, const ValType *, ValType *> ptr;
-    ValType **outer_arr;
+    friend class common_iterator<!IsConst>;
+
+    ValType *const *outer_arr = nullptr;
+    size_t pos = 0;
 
 public:
-    using iterator_category = std::bidirectional_iterator_tag;
+    using iterator_category = std::random_access_iterator_tag;
     using value_type = ValType;
-    using pointer = ValType *;
-    using reference = ValType &;
+    using pointer = std::conditional_t<IsConst, const ValType *, ValType *>;
+    using reference = std::conditional_t<IsConst, const ValType &, ValType &>;
     using difference_type = std::ptrdiff_t;
 
-    common_iterator(int index, const Deque<ValType> &in_deq);
+    common_iterator() = default;
+    common_iterator(size_t index, const Deque<ValType, RowLength> &in_deq);
 
-    std::conditional_t<IsConst, const ValType &, ValType &> operator*();
-    std::conditional_t<IsConst, const ValType *, ValType *> operator->();
+    // iterator converts to const_iterator
+    template <bool OtherConst, typename = std::enable_if_t<IsConst && !OtherConst>>
+    common_iterator(const common_iterator<OtherConst> &other);
 
-    Deque<ValType>::common_iterator<IsConst> &operator++();
-    Deque<ValType>::common_iterator<IsConst> &operator--();
-    Deque<ValType>::common_iterator<IsConst> &operator+=(size_t incr);
-    Deque<ValType>::common_iterator<IsConst> &operator-=(size_t decr);
+    reference operator*() const;
+    pointer operator->() const;
+    reference operator[](difference_type offset) const;
 
-    // iter comparison
-    int operator-(const common_iterator<IsConst> &other);
-    bool operator<(const common_iterator<IsConst> &other);
-    bool operator>(const common_iterator<IsConst> &other);
-    bool operator<=(const common_iterator<IsConst> &other);
-    bool operator>=(const common_iterator<IsConst> &other);
-    bool operator==(const common_iterator<IsConst> &other);
-    bool operator!=(const common_iterator<IsConst> &other);
+    common_iterator &operator++();
+    common_iterator &operator--();
+    common_iterator operator++(int);
+    common_iterator operator--(int);
+    common_iterator &operator+=(difference_type incr);
+    common_iterator &operator-=(difference_type decr);
 
     // big arithmetic
-    Deque<ValType>::common_iterator<IsConst> operator+(int summand)
-    {
-        std::cerr << "calling + iter " << summand << " ";
-        Deque<ValType>::common_iterator<IsConst> copy(*this);
-        copy += summand;
-        return copy;
-    }
+    common_iterator operator+(difference_type summand) const;
+    common_iterator operator-(difference_type summand) const;
 
-    Deque<ValType>::common_iterator<IsConst> operator-(int summand)
+    friend common_iterator operator+(difference_type summand, const common_iterator &iter)
     {
-        std::cerr << "calling - iter " << summand << " ";
-        Deque<ValType>::common_iterator<IsConst> copy(*this);
-        copy -= summand;
-        return copy;
+        return iter + summand;
     }
+
+    // iter comparison, iterators and const_iterators mix freely
+    template <bool OtherConst>
+    difference_type operator-(const common_iterator<OtherConst> &other) const;
+    template <bool OtherConst>
+    bool operator<(const common_iterator<OtherConst> &other) const;
+    template <bool OtherConst>
+    bool operator>(const common_iterator<OtherConst> &other) const;
+    template <bool OtherConst>
+    bool operator<=(const common_iterator<OtherConst> &other) const;
+    template <bool OtherConst>
+    bool operator>=(const common_iterator<OtherConst> &other) const;
+    template <bool OtherConst>
+    bool operator==(const common_iterator<OtherConst> &other) const;
+    template <bool OtherConst>
+    bool operator!=(const common_iterator<OtherConst> &other) const;
 };
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-Deque<ValType>::common_iterator<IsConst>::common_iterator(int index, const Deque<ValType> &in_deq)
+Deque<ValType, RowLength>::common_iterator<IsConst>::common_iterator(size_t index, const Deque<ValType, RowLength> &in_deq)
+    : outer_arr(in_deq.rows), pos(in_deq.base_row_ind * row_length + in_deq.zero_ind + index)
 {
-    in_row_ind = (in_deq.zero_ind + index) % row_length;
-    row_ind = in_deq.base_row_ind + ((in_deq.zero_ind + index) / row_length);
-    outer_arr = in_deq.rows;
-    ptr = outer_arr[row_ind] + in_row_ind;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-Deque<ValType>::common_iterator<IsConst> &Deque<ValType>::common_iterator<IsConst>::operator+=(size_t incr)
+template <bool OtherConst, typename>
+Deque<ValType, RowLength>::common_iterator<IsConst>::common_iterator(const common_iterator<OtherConst> &other)
+    : outer_arr(other.outer_arr), pos(other.pos)
 {
-    size_t new_row_ind = ((in_row_ind + incr) / row_length) + row_ind;
-    size_t new_in_row_ind = (in_row_ind + incr) % row_length;
+}
 
-    row_ind = new_row_ind;
-    in_row_ind = new_in_row_ind;
+template <typename ValType, size_t RowLength>
+template <bool IsConst>
+typename Deque<ValType, RowLength>::template common_iterator<IsConst>::reference Deque<ValType, RowLength>::common_iterator<IsConst>::operator*() const
+{
+    return outer_arr[row_of(pos)][in_row(pos)];
+}
 
-    ptr = outer_arr[row_ind] + in_row_ind;
+template <typename ValType, size_t RowLength>
+template <bool IsConst>
+typename Deque<ValType, RowLength>::template common_iterator<IsConst>::pointer Deque<ValType, RowLength>::common_iterator<IsConst>::operator->() const
+{
+    return outer_arr[row_of(pos)] + in_row(pos);
+}
 
+template <typename ValType, size_t RowLength>
+template <bool IsConst>
+typename Deque<ValType, RowLength>::template common_iterator<IsConst>::reference Deque<ValType, RowLength>::common_iterator<IsConst>::operator[](difference_type offset) const
+{
+    size_t index = pos + offset;
+    return outer_arr[row_of(index)][in_row(index)];
+}
+
+template <typename ValType, size_t RowLength>
+template <bool IsConst>
+typename Deque<ValType, RowLength>::template common_iterator<IsConst> &Deque<ValType, RowLength>::common_iterator<IsConst>::operator+=(difference_type incr)
+{
+    // unsigned wrap-around makes negative steps work too
+    pos += incr;
     return *this;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-Deque<ValType>::common_iterator<IsConst> &Deque<ValType>::common_iterator<IsConst>::operator-=(size_t decr)
+typename Deque<ValType, RowLength>::template common_iterator<IsConst> &Deque<ValType, RowLength>::common_iterator<IsConst>::operator-=(difference_type decr)
 {
-    size_t go_back_rows = decr / row_length;
-    size_t go_back_ind = decr % row_length;
+    pos -= decr;
+    return *this;
+}
 
-    if (go_back_rows <= row_ind)
-    {
-        row_ind -= go_back_rows;
-        if (go_back_ind <= in_row_ind)
-        {
-            in_row_ind -= go_back_ind;
-            ptr = outer_arr[row_ind] + in_row_ind;
-        }
-        else
-        {
-            if (row_ind > 0)
-            {
-                --row_ind;
-                in_row_ind = in_row_ind + row_length - go_back_ind;
-                ptr = outer_arr[row_ind] + in_row_ind;
-            }
-        }
-    }
+template <typename ValType, size_t RowLength>
+template <bool IsConst>
+typename Deque<ValType, RowLength>::template common_iterator<IsConst> &Deque<ValType, RowLength>::common_iterator<IsConst>::operator++()
+{
+    ++pos;
+    return *this;
+}
 
-    return (*this);
+template <typename ValType, size_t RowLength>
+template <bool IsConst>
+typename Deque<ValType, RowLength>::template common_iterator<IsConst> &Deque<ValType, RowLength>::common_iterator<IsConst>::operator--()
+{
+    --pos;
+    return *this;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-Deque<ValType>::common_iterator<IsConst> &Deque<ValType>::common_iterator<IsConst>::operator++()
+typename Deque<ValType, RowLength>::template common_iterator<IsConst> Deque<ValType, RowLength>::common_iterator<IsConst>::operator++(int)
 {
-    return (*this += 1);
+    common_iterator copy(*this);
+    ++pos;
+    return copy;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-Deque<ValType>::common_iterator<IsConst> &Deque<ValType>::common_iterator<IsConst>::operator--()
+typename Deque<ValType, RowLength>::template common_iterator<IsConst> Deque<ValType, RowLength>::common_iterator<IsConst>::operator--(int)
 {
-    return (*this -= 1);
+    common_iterator copy(*this);
+    --pos;
+    return copy;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-std::conditional_t<IsConst, const ValType &, ValType &> Deque<ValType>::common_iterator<IsConst>::operator*()
+typename Deque<ValType, RowLength>::template common_iterator<IsConst> Deque<ValType, RowLength>::common_iterator<IsConst>::operator+(difference_type summand) const
 {
-    return *ptr;
+    common_iterator copy(*this);
+    copy += summand;
+    return copy;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-std::conditional_t<IsConst, const ValType *, ValType *> Deque<ValType>::common_iterator<IsConst>::operator->()
+typename Deque<ValType, RowLength>::template common_iterator<IsConst> Deque<ValType, RowLength>::common_iterator<IsConst>::operator-(difference_type summand) const
 {
-    return ptr;
+    common_iterator copy(*this);
+    copy -= summand;
+    return copy;
 }
 
 // iter diff
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-int Deque<ValType>::common_iterator<IsConst>::operator-(const Deque<ValType>::common_iterator<IsConst> &other)
+template <bool OtherConst>
+typename Deque<ValType, RowLength>::template common_iterator<IsConst>::difference_type Deque<ValType, RowLength>::common_iterator<IsConst>::operator-(const common_iterator<OtherConst> &other) const
 {
-    return ((row_ind - other.row_ind) * row_length + (in_row_ind - other.in_row_ind));
+    return static_cast<difference_type>(pos - other.pos);
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-bool Deque<ValType>::common_iterator<IsConst>::operator<(const Deque<ValType>::common_iterator<IsConst> &other)
+template <bool OtherConst>
+bool Deque<ValType, RowLength>::common_iterator<IsConst>::operator<(const common_iterator<OtherConst> &other) const
 {
-    return (*this - other) < 0;
+    return pos < other.pos;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-bool Deque<ValType>::common_iterator<IsConst>::operator>(const Deque<ValType>::common_iterator<IsConst> &other)
+template <bool OtherConst>
+bool Deque<ValType, RowLength>::common_iterator<IsConst>::operator>(const common_iterator<OtherConst> &other) const
 {
-    return other > (*this);
+    return pos > other.pos;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-bool Deque<ValType>::common_iterator<IsConst>::operator<=(const Deque<ValType>::common_iterator<IsConst> &other)
+template <bool OtherConst>
+bool Deque<ValType, RowLength>::common_iterator<IsConst>::operator<=(const common_iterator<OtherConst> &other) const
 {
-    return !(*this > other);
+    return pos <= other.pos;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-bool Deque<ValType>::common_iterator<IsConst>::operator>=(const Deque<ValType>::common_iterator<IsConst> &other)
+template <bool OtherConst>
+bool Deque<ValType, RowLength>::common_iterator<IsConst>::operator>=(const common_iterator<OtherConst> &other) const
 {
-    return !(*this < other);
+    return pos >= other.pos;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-bool Deque<ValType>::common_iterator<IsConst>::operator==(const Deque<ValType>::common_iterator<IsConst> &other)
+template <bool OtherConst>
+bool Deque<ValType, RowLength>::common_iterator<IsConst>::operator==(const common_iterator<OtherConst> &other) const
 {
-    return (*this - other) == 0;
+    return pos == other.pos;
 }
 
-template <typename ValType>
+template <typename ValType, size_t RowLength>
 template <bool IsConst>
-bool Deque<ValType>::common_iterator<IsConst>::operator!=(const Deque<ValType>::common_iterator<IsConst> &other)
+template <bool OtherConst>
+bool Deque<ValType, RowLength>::common_iterator<IsConst>::operator!=(const common_iterator<OtherConst> &other) const
 {
-    return !(*this == other);
-}
\ No newline at end of file
+    return pos != other.pos;
+}
+
+#endif // DEQUE_CPP
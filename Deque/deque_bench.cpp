@@ -0,0 +1,123 @@
+#include "deque.cpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+// push, pop and index cost of Deque for several value sizes and row lengths
+// usage: DequeBench [elements]
+
+template <size_t Bytes>
+struct Payload
+{
+    uint64_t words[Bytes / sizeof(uint64_t)];
+
+    explicit Payload(uint64_t value = 0)
+    {
+        for (uint64_t &word : words)
+        {
+            word = value;
+        }
+    }
+};
+
+template <typename Func>
+double measure_ns(size_t ops, Func &&func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count() / static_cast<double>(ops);
+}
+
+template <typename ValType, size_t RowLength>
+void run_rows(const char *name, size_t elements, const std::vector<size_t> &indices)
+{
+    Deque<ValType, RowLength> bench_deque;
+    uint64_t sink = 0;
+
+    double push_back_ns = measure_ns(elements, [&]()
+    {
+        for (size_t i = 0; i < elements; i++)
+        {
+            bench_deque.emplace_back(i);
+        }
+    });
+
+    double index_ns = measure_ns(elements, [&]()
+    {
+        for (size_t i = 0; i < elements; i++)
+        {
+            sink += bench_deque[i].words[0];
+        }
+    });
+
+    double random_ns = measure_ns(indices.size(), [&]()
+    {
+        for (size_t index : indices)
+        {
+            sink += bench_deque[index].words[0];
+        }
+    });
+
+    double pop_front_ns = measure_ns(elements, [&]()
+    {
+        for (size_t i = 0; i < elements; i++)
+        {
+            bench_deque.pop_front();
+        }
+    });
+
+    double push_front_ns = measure_ns(elements, [&]()
+    {
+        for (size_t i = 0; i < elements; i++)
+        {
+            bench_deque.emplace_front(i);
+        }
+    });
+
+    double pop_back_ns = measure_ns(elements, [&]()
+    {
+        for (size_t i = 0; i < elements; i++)
+        {
+            bench_deque.pop_back();
+        }
+    });
+
+    std::cout << sizeof(ValType) << "\t" << name << "\t" << RowLength << "\t" << RowLength * sizeof(ValType)
+              << "\t" << elements << "\t" << push_back_ns << "\t" << push_front_ns << "\t" << pop_front_ns
+              << "\t" << pop_back_ns << "\t" << index_ns << "\t" << random_ns << "\t(" << sink % 10 << ")\n";
+}
+
+template <typename ValType>
+void run_value(size_t elements, const std::vector<size_t> &indices)
+{
+    run_rows<ValType, default_row_length<ValType>()>("default", elements, indices);
+    run_rows<ValType, 16>("fixed", elements, indices);
+    run_rows<ValType, 32>("fixed", elements, indices);
+    run_rows<ValType, 100>("fixed", elements, indices);
+    run_rows<ValType, 128>("fixed", elements, indices);
+    run_rows<ValType, 1024>("fixed", elements, indices);
+}
+
+int main(int argc, char **argv)
+{
+
+    size_t elements = (argc > 1 ? std::stoull(argv[1]) : 1000000);
+
+    std::mt19937_64 rng(42);
+    std::vector<size_t> indices(elements);
+    for (size_t &index : indices)
+    {
+        index = rng() % elements;
+    }
+
+    std::cout << "value bytes\trows\trow length\trow bytes\tsize\tpush_back ns\tpush_front ns\tpop_front ns"
+              << "\tpop_back ns\tindex ns\trandom ns\n";
+
+    run_value<Payload<8>>(elements, indices);
+    run_value<Payload<32>>(elements, indices);
+    run_value<Payload<128>>(elements, indices);
+    run_value<Payload<512>>(elements, indices);
+}
@@ -1,4 +1,8 @@
 #include "deque.cpp"
+#include "deque_stream.cpp"
+
+#include <iostream>
+#include <sstream>
 
 int main() {
 
@@ -12,4 +16,13 @@ int main() {
         std::cout << it << " ";
     }
 
-}
\ No newline at end of file
+    std::stringstream checkpoint;
+    write_stream(dq, checkpoint);
+    Deque<int> loaded_dq;
+    read_stream(checkpoint, loaded_dq);
+
+    for(auto it: loaded_dq){
+        std::cout << it << " ";
+    }
+
+}
@@ -0,0 +1,187 @@
+#ifndef DEQUE_STREAM_CPP
+#define DEQUE_STREAM_CPP
+
+#include "deque.cpp"
+#include "stream_framing.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+// Streaming dump of a deque of trivially copyable values, for checkpoints written to files
+// or pipes in bounded chunks framed as in stream_framing.cpp.
+// A data chunk holds whole rows of values. The writer passes row memory straight to the
+// stream and the reader fills the rows of the target in place, no element is copied on its own.
+// Torn, truncated or spliced streams fail a checksum and are rejected.
+
+struct DequeStreamHeader
+{
+    static constexpr uint64_t magic_value = 0x3152545351454455ull; // "UDEQSTR1"
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint32_t byte_order_mark = 0x01020304;
+
+    uint64_t magic;
+    uint32_t version, byte_order;
+    uint64_t value_size, size;
+};
+
+template <typename ValType, size_t RowLength>
+class DequeStream
+{
+    static_assert(std::is_trivially_copyable<ValType>::value, "streams only hold trivially copyable values");
+
+    static const size_t row_length = RowLength;
+
+    // fn(ValType *, count) over the pieces of rows holding positions [first, first + amount),
+    // positions past the size are fine as long as their rows are allocated
+    template <typename Fn>
+    static void for_each_slice(const Deque<ValType, RowLength> &deque, size_t first, size_t amount, Fn &&fn);
+
+public:
+    static void write(const Deque<ValType, RowLength> &deque, std::ostream &out, size_t chunk_bytes);
+    static void read(std::istream &in, Deque<ValType, RowLength> &deque);
+};
+
+template <typename ValType, size_t RowLength>
+template <typename Fn>
+void DequeStream<ValType, RowLength>::for_each_slice(const Deque<ValType, RowLength> &deque, size_t first, size_t amount, Fn &&fn)
+{
+    size_t index = deque.zero_ind + first;
+    while (amount != 0)
+    {
+        size_t in_row_ind = index % row_length;
+        size_t slice = std::min(amount, row_length - in_row_ind);
+
+        fn(deque.rows[deque.base_row_ind + index / row_length] + in_row_ind, slice);
+        index += slice;
+        amount -= slice;
+    }
+}
+
+template <typename ValType, size_t RowLength>
+void DequeStream<ValType, RowLength>::write(const Deque<ValType, RowLength> &deque, std::ostream &out, size_t chunk_bytes)
+{
+    // chunks are cut on whole rows, at least one
+    size_t row_bytes = row_length * sizeof(ValType);
+    size_t per_chunk = std::max<size_t>(1, std::min(chunk_bytes, StreamWriter::max_chunk_bytes) / row_bytes) * row_length;
+
+    DequeStreamHeader header{};
+    header.magic = DequeStreamHeader::magic_value;
+    header.version = DequeStreamHeader::current_version;
+    header.byte_order = DequeStreamHeader::byte_order_mark;
+    header.value_size = sizeof(ValType);
+    header.size = deque.sz;
+
+    StreamWriter writer(out);
+    writer.write_chunk(&header, sizeof(header), 1);
+
+    for (size_t first = 0; first < deque.sz; first += per_chunk)
+    {
+        size_t records = std::min(per_chunk, deque.sz - first);
+
+        writer.begin_chunk(records * sizeof(ValType), records);
+        for_each_slice(deque, first, records, [&writer](const ValType *slice, size_t amount)
+        {
+            writer.write(slice, amount * sizeof(ValType));
+        });
+        writer.end_chunk();
+    }
+
+    writer.finish();
+}
+
+template <typename ValType, size_t RowLength>
+void DequeStream<ValType, RowLength>::read(std::istream &in, Deque<ValType, RowLength> &deque)
+{
+    StreamReader reader(in);
+    DequeStreamHeader header;
+    reader.read_chunk(&header, sizeof(header));
+
+    if (header.magic != DequeStreamHeader::magic_value || header.version != DequeStreamHeader::current_version ||
+        header.byte_order != DequeStreamHeader::byte_order_mark)
+    {
+        throw std::runtime_error("Not a deque stream of this version and byte order");
+    }
+    if (header.value_size != sizeof(ValType))
+    {
+        throw std::runtime_error("Stream was written for another value type");
+    }
+
+    if (header.size > std::numeric_limits<size_t>::max() - deque.sz)
+    {
+        throw std::runtime_error("Stream does not fit the deque");
+    }
+
+    uint64_t loaded = 0;
+    while (loaded < header.size)
+    {
+        size_t records = reader.begin_chunk(sizeof(ValType));
+        if (records == 0 || records > header.size - loaded)
+        {
+            throw std::runtime_error("Stream chunk is corrupted");
+        }
+
+        // rows are allocated chunk by chunk past the current back, never more than the chunk holds
+        deque.reserve_back(records);
+        for_each_slice(deque, deque.sz, records, [&reader](ValType *slice, size_t amount)
+        {
+            reader.read(slice, amount * sizeof(ValType));
+        });
+        reader.end_chunk();
+
+        // values of a chunk only become part of the deque once its checksum matched
+        deque.sz += records;
+        loaded += records;
+    }
+
+    if (reader.begin_chunk(sizeof(ValType)) != 0)
+    {
+        throw std::runtime_error("Stream chunk is corrupted");
+    }
+    reader.finish();
+}
+
+// writes deque to out, the rows go to the stream as they are
+template <typename ValType, size_t RowLength>
+void write_stream(const Deque<ValType, RowLength> &deque, std::ostream &out, size_t chunk_bytes = StreamWriter::default_chunk_bytes)
+{
+    DequeStream<ValType, RowLength>::write(deque, out, chunk_bytes);
+}
+
+// appends the values of a stream to the back of deque. Throws std::runtime_error on a foreign,
+// truncated or corrupted stream, values of the chunks verified before that stay appended.
+template <typename ValType, size_t RowLength>
+void read_stream(std::istream &in, Deque<ValType, RowLength> &deque)
+{
+    DequeStream<ValType, RowLength>::read(in, deque);
+}
+
+template <typename ValType, size_t RowLength>
+void save_stream(const Deque<ValType, RowLength> &deque, const std::string &path, size_t chunk_bytes = StreamWriter::default_chunk_bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        throw std::runtime_error("Cannot open stream " + path);
+    }
+    write_stream(deque, out, chunk_bytes);
+}
+
+template <typename ValType, size_t RowLength>
+void load_stream(const std::string &path, Deque<ValType, RowLength> &deque)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Cannot open stream " + path);
+    }
+    read_stream(in, deque);
+}
+
+#endif // DEQUE_STREAM_CPP
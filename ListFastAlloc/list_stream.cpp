@@ -0,0 +1,146 @@
+#ifndef LIST_STREAM_CPP
+#define LIST_STREAM_CPP
+
+#include "listfastalloc.cpp"
+#include "stream_framing.cpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Streaming dump of a list of trivially copyable values, for checkpoints written to files
+// or pipes in bounded chunks framed as in stream_framing.cpp.
+// A data chunk payload is the values packed back to back. Torn, truncated or spliced streams
+// fail a checksum and are rejected.
+
+struct ListStreamHeader
+{
+    static constexpr uint64_t magic_value = 0x315254535453494Cull; // "LISTSTR1"
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint32_t byte_order_mark = 0x01020304;
+
+    uint64_t magic;
+    uint32_t version, byte_order;
+    uint64_t value_size, size;
+};
+
+// writes list to out, values are gathered from the nodes into one chunk buffer of at most
+// chunk_bytes, so the stream sees a few large writes instead of one per element
+template <typename T, typename Alloc>
+void write_stream(const List<T, Alloc> &list, std::ostream &out, size_t chunk_bytes = StreamWriter::default_chunk_bytes)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "streams only hold trivially copyable values");
+
+    size_t per_chunk = std::max<size_t>(1, std::min(chunk_bytes, StreamWriter::max_chunk_bytes) / sizeof(T));
+
+    ListStreamHeader header{};
+    header.magic = ListStreamHeader::magic_value;
+    header.version = ListStreamHeader::current_version;
+    header.byte_order = ListStreamHeader::byte_order_mark;
+    header.value_size = sizeof(T);
+    header.size = list.size();
+
+    StreamWriter writer(out);
+    writer.write_chunk(&header, sizeof(header), 1);
+
+    std::vector<char> buffer(std::min(per_chunk, list.size()) * sizeof(T));
+    size_t records = 0;
+    for (auto iter = list.cbegin(); iter != list.cend(); ++iter)
+    {
+        std::memcpy(buffer.data() + records * sizeof(T), &*iter, sizeof(T));
+
+        if (++records == per_chunk)
+        {
+            writer.write_chunk(buffer.data(), records * sizeof(T), records);
+            records = 0;
+        }
+    }
+    if (records != 0)
+    {
+        writer.write_chunk(buffer.data(), records * sizeof(T), records);
+    }
+
+    writer.finish();
+}
+
+// appends the values of a stream to the back of list. Throws std::runtime_error on a foreign,
+// truncated or corrupted stream, values of the chunks verified before that stay appended.
+template <typename T, typename Alloc>
+void read_stream(std::istream &in, List<T, Alloc> &list)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "streams only hold trivially copyable values");
+
+    StreamReader reader(in);
+    ListStreamHeader header;
+    reader.read_chunk(&header, sizeof(header));
+
+    if (header.magic != ListStreamHeader::magic_value || header.version != ListStreamHeader::current_version ||
+        header.byte_order != ListStreamHeader::byte_order_mark)
+    {
+        throw std::runtime_error("Not a list stream of this version and byte order");
+    }
+    if (header.value_size != sizeof(T))
+    {
+        throw std::runtime_error("Stream was written for another value type");
+    }
+
+    std::vector<char> buffer;
+    uint64_t loaded = 0;
+    while (loaded < header.size)
+    {
+        size_t records = reader.begin_chunk(sizeof(T));
+        if (records == 0 || records > header.size - loaded)
+        {
+            throw std::runtime_error("Stream chunk is corrupted");
+        }
+
+        buffer.resize(records * sizeof(T));
+        reader.read(buffer.data(), buffer.size());
+        reader.end_chunk();
+
+        for (size_t i = 0; i < records; i++)
+        {
+            // the value is copied out as raw bytes, T needs no default constructor
+            alignas(T) unsigned char value[sizeof(T)];
+            std::memcpy(value, buffer.data() + i * sizeof(T), sizeof(T));
+            list.push_back(*reinterpret_cast<const T *>(value));
+        }
+        loaded += records;
+    }
+
+    if (reader.begin_chunk(sizeof(T)) != 0)
+    {
+        throw std::runtime_error("Stream chunk is corrupted");
+    }
+    reader.finish();
+}
+
+template <typename T, typename Alloc>
+void save_stream(const List<T, Alloc> &list, const std::string &path, size_t chunk_bytes = StreamWriter::default_chunk_bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        throw std::runtime_error("Cannot open stream " + path);
+    }
+    write_stream(list, out, chunk_bytes);
+}
+
+template <typename T, typename Alloc>
+void load_stream(const std::string &path, List<T, Alloc> &list)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Cannot open stream " + path);
+    }
+    read_stream(in, list);
+}
+
+#endif // LIST_STREAM_CPP
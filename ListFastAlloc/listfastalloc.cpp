@@ -1,3 +1,10 @@
+#ifndef LISTFASTALLOC_CPP
+#define LISTFASTALLOC_CPP
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 const size_t global_chunk_size = 32;
@@ -655,7 +662,7 @@ void FastAllocator<T>::deallocate(T *ptr, size_t amount)
 
 template <typename T>
 template <typename U>
-FastAllocator<T>::FastAllocator(const FastAllocator<U> &other) : chunk_allock(other.chunk_alloc)
+FastAllocator<T>::FastAllocator(const FastAllocator<U> &other) : chunk_allock(other.chunk_allock)
 {
 }
 
@@ -675,3 +682,5 @@ bool operator!=(const FastAllocator<T> &left, const FastAllocator<T> &right)
 {
     return false;
 }
+
+#endif // LISTFASTALLOC_CPP
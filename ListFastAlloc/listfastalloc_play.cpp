@@ -1,5 +1,7 @@
 #include "listfastalloc.cpp"
+#include "list_stream.cpp"
 #include <iostream>
+#include <sstream>
 
 int main() {
 
@@ -30,4 +32,11 @@ int main() {
 
     std::cout << current_back << " " << current_front << "\n";
 
+    std::stringstream checkpoint;
+    write_stream(lst, checkpoint);
+    List<int> loaded_lst;
+    read_stream(checkpoint, loaded_lst);
+
+    std::cout << *loaded_lst.rbegin() << " " << *loaded_lst.begin() << "\n";
+
 }
\ No newline at end of file
@@ -0,0 +1,352 @@
+#ifndef CONCURRENT_UNORDERED_MAP_CPP
+#define CONCURRENT_UNORDERED_MAP_CPP
+
+#include "unordered_map.cpp"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+
+// lock striped wrapper over the chained engine: the key space is split into shards by the
+// high bits of the mixed hash, every shard is an ordinary UnorderedMap behind its own
+// reader/writer lock. Readers of one shard run in parallel, writers only block their shard.
+// The full hash is computed once and handed to the shard, so the shard and its bucket
+// come from the same hasher call.
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>, typename Alloc = std::allocator<std::pair<const Key, Value>>,
+          typename Storage = ChainedStorage<true>>
+class ConcurrentUnorderedMap
+{
+public:
+    using Map = UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>;
+    using NodeType = typename Map::NodeType;
+
+    static constexpr size_t cache_line = 64;
+    static constexpr bool transparent = Map::transparent;
+
+private:
+    using ListConstIterator = typename Map::ListConstIterator;
+
+    // each shard owns whole cache lines, so locking one never invalidates its neighbours
+    struct alignas(cache_line) Shard
+    {
+        mutable std::shared_mutex lock;
+        Map map;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    size_t shard_count, shard_shift;
+
+    Hash hash_fn;
+
+    template <typename K>
+    using EnableKey = std::enable_if_t<transparent || std::is_convertible<K, Key>::value>;
+
+    static size_t default_shards();
+
+    size_t shard_of(size_t hash) const;
+
+    template <typename K>
+    decltype(auto) lookup(const K &key) const;
+
+public:
+    explicit ConcurrentUnorderedMap(size_t shards_wanted = default_shards(), const Hash &hash = Hash(),
+                                    const Equal &equal = Equal(), const Alloc &alloc = Alloc());
+
+    ConcurrentUnorderedMap(const ConcurrentUnorderedMap &other) = delete;
+    ConcurrentUnorderedMap &operator=(const ConcurrentUnorderedMap &other) = delete;
+
+    size_t shards_count() const;
+
+    // sum over the shards, exact only while no writer runs
+    size_t size() const;
+    bool empty() const;
+
+    void reserve(size_t needed_cap);
+    void clear();
+
+    template <typename K, typename = EnableKey<K>>
+    std::optional<Value> find(const K &key) const;
+
+    template <typename K, typename = EnableKey<K>>
+    bool contains(const K &key) const;
+
+    bool insert(const NodeType &ins_pair);
+    bool insert(NodeType &&ins_pair);
+
+    template <typename K, typename... Args>
+    bool try_emplace(K &&key, Args &&...args);
+
+    template <typename K, typename M>
+    bool insert_or_assign(K &&key, M &&obj);
+
+    template <typename K, typename = EnableKey<K>>
+    size_t erase(const K &key);
+
+    // fn(Value &) runs on an existing value, otherwise a value built from args is inserted,
+    // returns true when the key was inserted
+    template <typename K, typename Fn, typename... Args>
+    bool upsert(K &&key, Fn &&fn, Args &&...args);
+
+    // fn runs under the shard lock, shared for the const overload and exclusive otherwise,
+    // returns false when the key is absent
+    template <typename K, typename Fn, typename = EnableKey<K>>
+    bool visit(const K &key, Fn &&fn) const;
+
+    template <typename K, typename Fn, typename = EnableKey<K>>
+    bool visit(const K &key, Fn &&fn);
+
+    // fn(const NodeType &) over every element, one shard locked at a time
+    template <typename Fn>
+    void visit_all(Fn &&fn) const;
+};
+
+// construction
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::default_shards()
+{
+    // a few shards per hardware thread keep two writers on one stripe unlikely
+    size_t threads = std::thread::hardware_concurrency();
+    return (threads == 0 ? 16 : threads * 4);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConcurrentUnorderedMap(size_t shards_wanted, const Hash &hash,
+                                                                                        const Equal &equal, const Alloc &alloc)
+    : shard_count(1), shard_shift(64), hash_fn(hash)
+{
+    while (shard_count < shards_wanted && shard_count < (size_t(1) << 16))
+    {
+        shard_count <<= 1;
+        --shard_shift;
+    }
+
+    shards.reset(new Shard[shard_count]);
+    for (size_t i = 0; i < shard_count; i++)
+    {
+        shards[i].map = Map(Map::init_cap, hash, equal, alloc);
+    }
+}
+
+// helpers
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::shard_of(size_t hash) const
+{
+    // the top bits of the mixed hash pick the shard, the shard map reduces the raw hash,
+    // so both choices stay independent
+    if (shard_count == 1)
+    {
+        return 0;
+    }
+    return static_cast<size_t>(mix_hash_bits(hash) >> shard_shift);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K>
+decltype(auto) ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::lookup(const K &key) const
+{
+    return lookup_key<Key, transparent>(key);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::shards_count() const
+{
+    return shard_count;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::size() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < shard_count; i++)
+    {
+        std::shared_lock<std::shared_mutex> guard(shards[i].lock);
+        total += shards[i].map.size();
+    }
+    return total;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::empty() const
+{
+    return size() == 0;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::reserve(size_t needed_cap)
+{
+    size_t per_shard = needed_cap / shard_count + 1;
+    for (size_t i = 0; i < shard_count; i++)
+    {
+        std::unique_lock<std::shared_mutex> guard(shards[i].lock);
+        shards[i].map.reserve(per_shard);
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::clear()
+{
+    for (size_t i = 0; i < shard_count; i++)
+    {
+        std::unique_lock<std::shared_mutex> guard(shards[i].lock);
+        shards[i].map.erase(shards[i].map.cbegin(), shards[i].map.cend());
+    }
+}
+
+// lookup
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename>
+std::optional<Value> ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find(const K &key) const
+{
+    std::optional<Value> result;
+    visit(key, [&result](const Value &value)
+    {
+        result.emplace(value);
+    });
+    return result;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::contains(const K &key) const
+{
+    return visit(key, [](const Value &)
+    {
+    });
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename Fn, typename>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::visit(const K &key, Fn &&fn) const
+{
+    const auto &probe = lookup(key);
+    size_t hash = hash_fn(probe);
+    const Shard &shard = shards[shard_of(hash)];
+
+    // only const lookups run here, they never advance an incremental rehash
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    auto pos = shard.map.find_in_bucket(probe, hash);
+    if (!pos.second)
+    {
+        return false;
+    }
+
+    fn(static_cast<const Value &>(pos.first->value.second));
+    return true;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename Fn, typename>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::visit(const K &key, Fn &&fn)
+{
+    const auto &probe = lookup(key);
+    size_t hash = hash_fn(probe);
+    Shard &shard = shards[shard_of(hash)];
+
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    auto pos = shard.map.find_in_bucket(probe, hash);
+    if (!pos.second)
+    {
+        return false;
+    }
+
+    fn(pos.first->value.second);
+    return true;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename Fn>
+void ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::visit_all(Fn &&fn) const
+{
+    for (size_t i = 0; i < shard_count; i++)
+    {
+        std::shared_lock<std::shared_mutex> guard(shards[i].lock);
+        for (auto iter = shards[i].map.cbegin(); iter != shards[i].map.cend(); ++iter)
+        {
+            fn(*iter);
+        }
+    }
+}
+
+// modification
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::insert(const NodeType &ins_pair)
+{
+    size_t hash = hash_fn(ins_pair.first);
+    Shard &shard = shards[shard_of(hash)];
+
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    return shard.map.emplace_hashed(ins_pair.first, hash, ins_pair).second;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::insert(NodeType &&ins_pair)
+{
+    size_t hash = hash_fn(ins_pair.first);
+    Shard &shard = shards[shard_of(hash)];
+
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    return shard.map.emplace_hashed(ins_pair.first, hash, std::move(ins_pair)).second;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename... Args>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::try_emplace(K &&key, Args &&...args)
+{
+    return upsert(std::forward<K>(key), [](Value &)
+    {
+    }, std::forward<Args>(args)...);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename M>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::insert_or_assign(K &&key, M &&obj)
+{
+    // obj is consumed by exactly one of the two branches
+    return upsert(std::forward<K>(key), [&obj](Value &value)
+    {
+        value = std::forward<M>(obj);
+    }, std::forward<M>(obj));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename Fn, typename... Args>
+bool ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::upsert(K &&key, Fn &&fn, Args &&...args)
+{
+    const auto &probe = lookup(key);
+    size_t hash = hash_fn(probe);
+    Shard &shard = shards[shard_of(hash)];
+
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    // the pair is only built on a miss, on a hit key and args stay untouched
+    auto result = shard.map.emplace_hashed(probe, hash, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                           std::forward_as_tuple(std::forward<Args>(args)...));
+    if (!result.second)
+    {
+        fn(result.first->second);
+    }
+    return result.second;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename>
+size_t ConcurrentUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::erase(const K &key)
+{
+    const auto &probe = lookup(key);
+    size_t hash = hash_fn(probe);
+    Shard &shard = shards[shard_of(hash)];
+
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    auto pos = shard.map.find_in_bucket(probe, hash);
+    if (!pos.second)
+    {
+        return 0;
+    }
+
+    shard.map.erase(typename Map::ConstIterator(ListConstIterator(pos.first)));
+    return 1;
+}
+
+#endif // CONCURRENT_UNORDERED_MAP_CPP
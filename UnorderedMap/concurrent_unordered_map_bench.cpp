@@ -0,0 +1,146 @@
+
+#include "concurrent_unordered_map.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// throughput of the sharded map against one UnorderedMap behind a global mutex,
+// mixed workload: 80% visit, 10% upsert, 10% erase over a fixed key range
+// usage: ConcurrentUnorderedMapBench [max_threads] [ops_per_thread]
+
+constexpr uint64_t key_range = 1 << 20;
+
+class GlobalLockMap
+{
+    mutable std::mutex lock;
+    UnorderedMap<uint64_t, uint64_t> map;
+
+public:
+    bool visit(uint64_t key, uint64_t &sink) const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto pos = map.find(key);
+        if (pos == map.end())
+        {
+            return false;
+        }
+        sink += pos->second;
+        return true;
+    }
+
+    void upsert(uint64_t key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ++map[key];
+    }
+
+    void erase(uint64_t key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        map.erase(key);
+    }
+};
+
+class ShardedMap
+{
+    ConcurrentUnorderedMap<uint64_t, uint64_t> map;
+
+public:
+    bool visit(uint64_t key, uint64_t &sink) const
+    {
+        return map.visit(key, [&sink](const uint64_t &value)
+        {
+            sink += value;
+        });
+    }
+
+    void upsert(uint64_t key)
+    {
+        map.upsert(key, [](uint64_t &value)
+        {
+            ++value;
+        }, 1);
+    }
+
+    void erase(uint64_t key)
+    {
+        map.erase(key);
+    }
+};
+
+template <typename BenchMap>
+double run_threads(size_t threads, size_t ops_per_thread)
+{
+    BenchMap bench_map;
+    for (uint64_t key = 0; key < key_range; key += 2)
+    {
+        bench_map.upsert(key);
+    }
+
+    std::atomic<bool> start{false};
+    std::atomic<uint64_t> total_sink{0};
+    std::vector<std::thread> workers;
+
+    for (size_t t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            std::mt19937_64 rng(t + 1);
+            uint64_t sink = 0;
+            while (!start.load(std::memory_order_acquire))
+            {
+            }
+
+            for (size_t i = 0; i < ops_per_thread; i++)
+            {
+                uint64_t key = rng() % key_range;
+                uint64_t op = rng() % 10;
+                if (op < 8)
+                {
+                    bench_map.visit(key, sink);
+                }
+                else if (op == 8)
+                {
+                    bench_map.upsert(key);
+                }
+                else
+                {
+                    bench_map.erase(key);
+                }
+            }
+            total_sink += sink;
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    auto finish = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(finish - begin).count();
+    return static_cast<double>(threads * ops_per_thread) / seconds / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+
+    size_t hw_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t max_threads = (argc > 1 ? std::stoull(argv[1]) : hw_threads);
+    size_t ops_per_thread = (argc > 2 ? std::stoull(argv[2]) : 1000000);
+
+    std::cout << "threads\tglobal lock Mops/s\tsharded Mops/s\n";
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        double global_mops = run_threads<GlobalLockMap>(threads, ops_per_thread);
+        double sharded_mops = run_threads<ShardedMap>(threads, ops_per_thread);
+        std::cout << threads << "\t" << global_mops << "\t" << sharded_mops << "\n";
+    }
+}
@@ -0,0 +1,416 @@
+#ifndef READ_MOSTLY_UNORDERED_MAP_CPP
+#define READ_MOSTLY_UNORDERED_MAP_CPP
+
+#include "unordered_map.cpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+// epoch based reclamation shared by every read mostly map of the process.
+// A reader announces the global epoch it saw in its own slot and clears the slot when done,
+// both are plain stores, so the read path has no read-modify-write and no shared cache line.
+// A writer swaps the published pointer, advances the epoch and frees the old object once
+// no slot still holds an older epoch. Slots come in blocks, a new block is appended whenever
+// every slot is taken, so any number of threads can read.
+// The read section state of a thread is one thread_local, so the process has exactly one domain,
+// reached through global().
+class EpochDomain
+{
+public:
+    static constexpr size_t slots_per_block = 64;
+    static constexpr uint64_t idle = 0;
+
+    EpochDomain(const EpochDomain &other) = delete;
+    EpochDomain &operator=(const EpochDomain &other) = delete;
+    ~EpochDomain();
+
+    static EpochDomain &global();
+
+    class ReadGuard
+    {
+        EpochDomain *domain;
+
+    public:
+        explicit ReadGuard(EpochDomain &owner);
+        ~ReadGuard();
+
+        ReadGuard(const ReadGuard &other) = delete;
+        ReadGuard &operator=(const ReadGuard &other) = delete;
+    };
+
+    // blocks until every read section that may have seen the state before this call is over,
+    // calling it from inside a read section of the same thread never returns
+    void synchronize();
+
+private:
+    EpochDomain() = default;
+
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<uint64_t> epoch{idle};
+        std::atomic<bool> used{false};
+    };
+
+    // blocks are only appended and live as long as the domain
+    struct SlotBlock
+    {
+        ReaderSlot slots[slots_per_block];
+        std::atomic<SlotBlock *> next{nullptr};
+    };
+
+    // per thread slot and nesting depth, the slot is claimed once and given back at thread exit
+    struct ThreadState
+    {
+        ReaderSlot *slot = nullptr;
+        size_t depth = 0;
+
+        ~ThreadState();
+    };
+
+    alignas(64) std::atomic<uint64_t> epoch{1};
+    SlotBlock first_block;
+
+    static ThreadState &thread_state();
+    ReaderSlot *claim_slot();
+
+    void enter();
+    void leave();
+};
+
+inline EpochDomain::~EpochDomain()
+{
+    SlotBlock *block = first_block.next.load(std::memory_order_relaxed);
+    while (block != nullptr)
+    {
+        SlotBlock *next = block->next.load(std::memory_order_relaxed);
+        delete block;
+        block = next;
+    }
+}
+
+inline EpochDomain &EpochDomain::global()
+{
+    static EpochDomain domain;
+    return domain;
+}
+
+inline EpochDomain::ThreadState::~ThreadState()
+{
+    if (slot != nullptr)
+    {
+        slot->epoch.store(idle, std::memory_order_release);
+        slot->used.store(false, std::memory_order_release);
+    }
+}
+
+inline EpochDomain::ThreadState &EpochDomain::thread_state()
+{
+    static thread_local ThreadState state;
+    return state;
+}
+
+inline EpochDomain::ReaderSlot *EpochDomain::claim_slot()
+{
+    // first read section of a thread only, slots given back by exited threads are reused first
+    SlotBlock *block = &first_block;
+    while (true)
+    {
+        for (ReaderSlot &slot : block->slots)
+        {
+            bool expected = false;
+            if (!slot.used.load(std::memory_order_relaxed) &&
+                slot.used.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                return &slot;
+            }
+        }
+
+        SlotBlock *next = block->next.load(std::memory_order_seq_cst);
+        if (next == nullptr)
+        {
+            // the new block comes with its first slot taken, a thread that appended first wins
+            SlotBlock *fresh = new SlotBlock;
+            fresh->slots[0].used.store(true, std::memory_order_relaxed);
+            if (block->next.compare_exchange_strong(next, fresh, std::memory_order_seq_cst))
+            {
+                return &fresh->slots[0];
+            }
+            delete fresh;
+        }
+        block = next;
+    }
+}
+
+inline void EpochDomain::enter()
+{
+    ThreadState &state = thread_state();
+    if (state.depth++ != 0)
+    {
+        return;
+    }
+
+    if (state.slot == nullptr)
+    {
+        state.slot = claim_slot();
+    }
+
+    // the announcement has to be visible before the published pointer is read
+    state.slot->epoch.store(epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void EpochDomain::leave()
+{
+    ThreadState &state = thread_state();
+    if (--state.depth == 0)
+    {
+        state.slot->epoch.store(idle, std::memory_order_release);
+    }
+}
+
+inline void EpochDomain::synchronize()
+{
+    uint64_t target = epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+    // a block appended after this walk only holds readers that already see the new state
+    for (SlotBlock *block = &first_block; block != nullptr; block = block->next.load(std::memory_order_seq_cst))
+    {
+        for (ReaderSlot &slot : block->slots)
+        {
+            while (true)
+            {
+                uint64_t seen = slot.epoch.load(std::memory_order_seq_cst);
+                if (seen == idle || seen >= target)
+                {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+inline EpochDomain::ReadGuard::ReadGuard(EpochDomain &owner) : domain(&owner)
+{
+    domain->enter();
+}
+
+inline EpochDomain::ReadGuard::~ReadGuard()
+{
+    domain->leave();
+}
+
+// copy-on-write map for tables that are read all the time and rarely change:
+// readers run const lookups on the published snapshot inside an epoch read section,
+// writers are serialized, change a private copy and publish it with one pointer swap
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>, typename Alloc = std::allocator<std::pair<const Key, Value>>,
+          typename Storage = ChainedStorage<true>>
+class ReadMostlyUnorderedMap
+{
+public:
+    using Map = UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>;
+    using NodeType = typename Map::NodeType;
+
+private:
+    std::atomic<Map *> current;
+    std::mutex writer_lock;
+    EpochDomain &domain;
+
+    void publish(std::unique_ptr<Map> fresh);
+
+public:
+    explicit ReadMostlyUnorderedMap(const Hash &hash = Hash(), const Equal &equal = Equal(),
+                                    const Alloc &alloc = Alloc());
+    explicit ReadMostlyUnorderedMap(const Map &initial);
+
+    ReadMostlyUnorderedMap(const ReadMostlyUnorderedMap &other) = delete;
+    ReadMostlyUnorderedMap &operator=(const ReadMostlyUnorderedMap &other) = delete;
+
+    ~ReadMostlyUnorderedMap();
+
+    // fn(const Map &) sees one consistent snapshot, references into it die with the call
+    template <typename Fn>
+    decltype(auto) read(Fn &&fn) const;
+
+    template <typename K>
+    std::optional<Value> find(const K &key) const;
+
+    template <typename K>
+    bool contains(const K &key) const;
+
+    // fn(const Value &) runs inside the read section, returns false when the key is absent
+    template <typename K, typename Fn>
+    bool visit(const K &key, Fn &&fn) const;
+
+    size_t size() const;
+
+    // fn(Map &) edits a copy of the current snapshot, the copy replaces it when fn returns,
+    // batching several edits into one update pays for one copy only
+    template <typename Fn>
+    void update(Fn &&fn);
+
+    bool insert(const NodeType &ins_pair);
+
+    template <typename K, typename M>
+    bool insert_or_assign(K &&key, M &&obj);
+
+    template <typename K>
+    size_t erase(const K &key);
+
+    // drops everything, replaces the whole table without copying the old one
+    void assign(Map fresh);
+};
+
+// construction
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ReadMostlyUnorderedMap(const Hash &hash, const Equal &equal,
+                                                                                        const Alloc &alloc)
+    : current(new Map(Map::init_cap, hash, equal, alloc)), domain(EpochDomain::global())
+{
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ReadMostlyUnorderedMap(const Map &initial)
+    : current(new Map(initial)), domain(EpochDomain::global())
+{
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::~ReadMostlyUnorderedMap()
+{
+    // no reader may outlive the map itself
+    delete current.load(std::memory_order_relaxed);
+}
+
+// readers
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename Fn>
+decltype(auto) ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::read(Fn &&fn) const
+{
+    EpochDomain::ReadGuard guard(domain);
+    const Map &snapshot = *current.load(std::memory_order_acquire);
+    return fn(snapshot);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K>
+std::optional<Value> ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find(const K &key) const
+{
+    std::optional<Value> result;
+    visit(key, [&result](const Value &value)
+    {
+        result.emplace(value);
+    });
+    return result;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K>
+bool ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::contains(const K &key) const
+{
+    return read([&key](const Map &snapshot)
+    {
+        return snapshot.contains(key);
+    });
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename Fn>
+bool ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::visit(const K &key, Fn &&fn) const
+{
+    return read([&key, &fn](const Map &snapshot)
+    {
+        auto pos = snapshot.find(key);
+        if (pos == snapshot.end())
+        {
+            return false;
+        }
+
+        fn(pos->second);
+        return true;
+    });
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::size() const
+{
+    return read([](const Map &snapshot)
+    {
+        return snapshot.size();
+    });
+}
+
+// writers
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::publish(std::unique_ptr<Map> fresh)
+{
+    std::unique_ptr<Map> old(current.exchange(fresh.release(), std::memory_order_seq_cst));
+
+    // readers that could still hold the old snapshot finish before it is freed
+    domain.synchronize();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename Fn>
+void ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::update(Fn &&fn)
+{
+    std::lock_guard<std::mutex> guard(writer_lock);
+
+    std::unique_ptr<Map> fresh(new Map(*current.load(std::memory_order_relaxed)));
+    fn(*fresh);
+    publish(std::move(fresh));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+bool ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::insert(const NodeType &ins_pair)
+{
+    bool inserted = false;
+    update([&](Map &fresh)
+    {
+        inserted = fresh.insert(ins_pair).second;
+    });
+    return inserted;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename M>
+bool ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::insert_or_assign(K &&key, M &&obj)
+{
+    bool inserted = false;
+    update([&](Map &fresh)
+    {
+        inserted = fresh.insert_or_assign(std::forward<K>(key), std::forward<M>(obj)).second;
+    });
+    return inserted;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K>
+size_t ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::erase(const K &key)
+{
+    std::lock_guard<std::mutex> guard(writer_lock);
+
+    // a missing key costs no copy
+    if (!current.load(std::memory_order_relaxed)->contains(key))
+    {
+        return 0;
+    }
+
+    std::unique_ptr<Map> fresh(new Map(*current.load(std::memory_order_relaxed)));
+    size_t erased = fresh->erase(key);
+    publish(std::move(fresh));
+    return erased;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void ReadMostlyUnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::assign(Map fresh)
+{
+    std::lock_guard<std::mutex> guard(writer_lock);
+    publish(std::unique_ptr<Map>(new Map(std::move(fresh))));
+}
+
+#endif // READ_MOSTLY_UNORDERED_MAP_CPP
@@ -0,0 +1,117 @@
+
+#include "read_mostly_unordered_map.cpp"
+#include "concurrent_unordered_map.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// lookup throughput of the epoch based map against the shared_mutex sharded map while
+// one writer updates a key every millisecond
+// usage: ReadMostlyUnorderedMapBench [max_threads] [lookups_per_thread]
+
+constexpr uint64_t table_size = 1 << 16;
+
+template <typename Lookup, typename Update>
+double run_readers(size_t threads, size_t lookups, Lookup &&lookup, Update &&update)
+{
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> total_sink{0};
+    std::thread writer([&]()
+    {
+        for (uint64_t round = 0; !stop.load(std::memory_order_relaxed); round++)
+        {
+            update(round % table_size, round);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    std::vector<std::thread> readers;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++)
+    {
+        readers.emplace_back([&, t]()
+        {
+            std::mt19937_64 rng(t + 1);
+            uint64_t sink = 0;
+            for (size_t i = 0; i < lookups; i++)
+            {
+                sink += lookup(rng() % table_size);
+            }
+            total_sink += sink;
+        });
+    }
+    for (auto &reader : readers)
+    {
+        reader.join();
+    }
+    auto finish = std::chrono::steady_clock::now();
+
+    stop.store(true);
+    writer.join();
+
+    double seconds = std::chrono::duration<double>(finish - begin).count();
+    return static_cast<double>(threads * lookups) / seconds / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+
+    size_t hw_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t max_threads = (argc > 1 ? std::stoull(argv[1]) : hw_threads);
+    size_t lookups = (argc > 2 ? std::stoull(argv[2]) : 2000000);
+
+    ReadMostlyUnorderedMap<uint64_t, uint64_t> read_mostly;
+    ConcurrentUnorderedMap<uint64_t, uint64_t> sharded;
+
+    read_mostly.update([](UnorderedMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                                       std::allocator<std::pair<const uint64_t, uint64_t>>, ChainedStorage<true>> &table)
+    {
+        for (uint64_t key = 0; key < table_size; key++)
+        {
+            table[key] = key;
+        }
+    });
+    for (uint64_t key = 0; key < table_size; key++)
+    {
+        sharded.insert({key, key});
+    }
+
+    std::cout << "threads\tread mostly Mlookups/s\tsharded Mlookups/s\n";
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        double epoch_mops = run_readers(threads, lookups, [&](uint64_t key)
+        {
+            uint64_t found = 0;
+            read_mostly.visit(key, [&found](const uint64_t &value)
+            {
+                found = value;
+            });
+            return found;
+        }, [&](uint64_t key, uint64_t value)
+        {
+            read_mostly.insert_or_assign(key, value);
+        });
+
+        double sharded_mops = run_readers(threads, lookups, [&](uint64_t key)
+        {
+            uint64_t found = 0;
+            sharded.visit(key, [&found](const uint64_t &value)
+            {
+                found = value;
+            });
+            return found;
+        }, [&](uint64_t key, uint64_t value)
+        {
+            sharded.insert_or_assign(key, value);
+        });
+
+        std::cout << threads << "\t" << epoch_mops << "\t" << sharded_mops << "\n";
+    }
+}
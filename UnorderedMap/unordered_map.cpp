@@ -1,623 +1,2560 @@
+#ifndef UNORDERED_MAP_CPP
+#define UNORDERED_MAP_CPP
+
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
 #include <iostream>
+#include <iterator>
 #include <list>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+template<typename NodeType, typename Alloc>
+using List = std::list<NodeType, Alloc>;
+
+// keeps a hasher, comparator or allocator inside a map, empty non-final types are
+// stored as a base class and take no space
+template <typename T, int Tag, bool IsEmpty = std::is_empty<T>::value && !std::is_final<T>::value>
+class EboHolder : private T
+{
+public:
+    EboHolder() = default;
+
+    explicit EboHolder(const T &value) : T(value)
+    {
+    }
+
+    explicit EboHolder(T &&value) : T(std::move(value))
+    {
+    }
+
+    T &get()
+    {
+        return *this;
+    }
+
+    const T &get() const
+    {
+        return *this;
+    }
+};
+
+template <typename T, int Tag>
+class EboHolder<T, Tag, false>
+{
+    T value;
+
+public:
+    EboHolder() = default;
+
+    explicit EboHolder(const T &init_value) : value(init_value)
+    {
+    }
+
+    explicit EboHolder(T &&init_value) : value(std::move(init_value))
+    {
+    }
+
+    T &get()
+    {
+        return value;
+    }
+
+    const T &get() const
+    {
+        return value;
+    }
+};
+
+// Hash and Equal opt into heterogeneous lookup by declaring is_transparent
+template <typename T, typename = void>
+struct IsTransparent : std::false_type
+{
+};
+
+template <typename T>
+struct IsTransparent<T, std::void_t<typename T::is_transparent>> : std::true_type
+{
+};
+
+// a transparent map looks up with the given key as is, otherwise it is converted to Key once per lookup
+template <typename Key, bool Transparent, typename U>
+decltype(auto) lookup_key(const U &key)
+{
+    if constexpr (Transparent || std::is_same<U, Key>::value)
+    {
+        return (key);
+    }
+    else
+    {
+        return Key(key);
+    }
+}
+
+// lookup keys of one batch window: a key that has to be converted to Key is converted once by load
+// and kept for the probe pass, a key that is looked up as it is gets read from the range again
+template <typename Key, bool Transparent, typename KeyIt, size_t Window>
+class WindowKeys
+{
+    static constexpr bool converts =
+        !std::is_reference<decltype(lookup_key<Key, Transparent>(*std::declval<KeyIt &>()))>::value;
+
+    std::optional<Key> converted[converts ? Window : 1];
+
+public:
+    // key number ind of the window, iter points at it in the range
+    decltype(auto) load(size_t ind, const KeyIt &iter)
+    {
+        if constexpr (converts)
+        {
+            converted[ind].emplace(*iter);
+            return static_cast<const Key &>(*converted[ind]);
+        }
+        else
+        {
+            return lookup_key<Key, Transparent>(*iter);
+        }
+    }
+
+    decltype(auto) get(size_t ind, const KeyIt &iter) const
+    {
+        if constexpr (converts)
+        {
+            return static_cast<const Key &>(*converted[ind]);
+        }
+        else
+        {
+            return lookup_key<Key, Transparent>(*iter);
+        }
+    }
+};
+
+// range constructors only take iterators, so (count, hash) arguments never match them
+template <typename It>
+using RequireInputIter = std::enable_if_t<
+    std::is_convertible<typename std::iterator_traits<It>::iterator_category, std::input_iterator_tag>::value>;
+
+// executor of the parallel build/rehash: exec(task_count, fn) calls fn(0) .. fn(task_count - 1),
+// possibly concurrently, and returns once all of them are done, exec.concurrency() is the number
+// of tasks worth creating. Worker pools plug in with any type of the same shape. An exception of
+// a task is rethrown by exec once every task has finished.
+class ThreadExecutor
+{
+    size_t threads;
+
+public:
+    explicit ThreadExecutor(size_t thread_count = std::thread::hardware_concurrency())
+        : threads(thread_count == 0 ? 1 : thread_count)
+    {
+    }
+
+    size_t concurrency() const
+    {
+        return threads;
+    }
+
+    template <typename Fn>
+    void operator()(size_t task_count, Fn &&fn) const
+    {
+        size_t used = std::min(threads, task_count);
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(used);
+
+        // a throwing task stops its own share only, the others run to the end
+        auto run_share = [&fn, &errors, used, task_count](size_t worker)
+        {
+            try
+            {
+                for (size_t task = worker; task < task_count; task += used)
+                {
+                    fn(task);
+                }
+            }
+            catch (...)
+            {
+                errors[worker] = std::current_exception();
+            }
+        };
+
+        // the calling thread takes the first share
+        try
+        {
+            for (size_t worker = 1; worker < used; worker++)
+            {
+                workers.emplace_back(run_share, worker);
+            }
+        }
+        catch (...)
+        {
+            errors[0] = std::current_exception();
+        }
+        if (errors[0] == nullptr)
+        {
+            run_share(0);
+        }
+
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        for (const std::exception_ptr &error : errors)
+        {
+            if (error != nullptr)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+};
+
+// bucket index policies of the chained engine: capacity rounding, growth and hash -> bucket reduction
+// ModuloIndex - hash % capacity
+// MaskIndex - power of two capacity, mixed hash & (capacity - 1)
+// FastRangeIndex - (mixed hash * capacity) >> 64, Lemire's multiply-shift range reduction
+// PrimeIndex - prime capacities from a table, modulo through a precomputed multiplier (Lemire's fastmod)
+struct ModuloIndex
+{
+    size_t cap;
+
+    explicit ModuloIndex(size_t capacity = 1) : cap(capacity)
+    {
+    }
+
+    static size_t round_capacity(size_t wanted)
+    {
+        return (wanted == 0 ? 1 : wanted);
+    }
+
+    static size_t next_capacity(size_t capacity)
+    {
+        return capacity << 1;
+    }
+
+    size_t bucket(size_t hash) const
+    {
+        return hash % cap;
+    }
+};
+
+// hint that ptr is read soon, a no-op without the GCC/Clang builtin
+inline void prefetch_read(const void *ptr)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(ptr, 0, 3);
+#else
+    (void)ptr;
+#endif
+}
+
+// murmur3 finalizer, std::hash of integers is the identity and leaves the high bits empty
+inline uint64_t mix_hash_bits(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+struct MaskIndex
+{
+    size_t mask;
+
+    explicit MaskIndex(size_t capacity = 1) : mask(capacity - 1)
+    {
+    }
+
+    static size_t round_capacity(size_t wanted)
+    {
+        size_t capacity = 1;
+        while (capacity < wanted)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    static size_t next_capacity(size_t capacity)
+    {
+        return capacity << 1;
+    }
+
+    size_t bucket(size_t hash) const
+    {
+        return static_cast<size_t>(mix_hash_bits(hash)) & mask;
+    }
+};
+
+struct FastRangeIndex
+{
+    size_t cap;
+
+    explicit FastRangeIndex(size_t capacity = 1) : cap(capacity)
+    {
+    }
+
+    static size_t round_capacity(size_t wanted)
+    {
+        return (wanted == 0 ? 1 : wanted);
+    }
+
+    static size_t next_capacity(size_t capacity)
+    {
+        return capacity << 1;
+    }
+
+    size_t bucket(size_t hash) const
+    {
+        // the high bits of the product decide the bucket, so the hash is mixed with one multiply
+        uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+#if defined(__SIZEOF_INT128__)
+        return static_cast<size_t>((static_cast<unsigned __int128>(mixed) * cap) >> 64);
+#else
+        return static_cast<size_t>(((mixed >> 32) * static_cast<uint64_t>(cap)) >> 32);
+#endif
+    }
+};
+
+struct PrimeIndex
+{
+    static constexpr uint32_t primes[] = {11, 23, 47, 97, 197, 397, 797, 1597, 3203, 6421, 12853, 25717, 51437, 102877,
+                                          205759, 411527, 823117, 1646237, 3292489, 6584983, 13169977, 26339969, 52679969,
+                                          105359939, 210719881, 421439783, 842879579, 1685759167, 3371518343u};
+
+    uint32_t divisor;
+    // ceil(2^64 / divisor), turns the modulo into two multiplications
+    uint64_t multiplier;
+
+    explicit PrimeIndex(size_t capacity = primes[0]) : divisor(static_cast<uint32_t>(capacity)),
+                                                       multiplier(UINT64_C(0xFFFFFFFFFFFFFFFF) / divisor + 1)
+    {
+    }
+
+    static size_t round_capacity(size_t wanted)
+    {
+        for (uint32_t prime : primes)
+        {
+            if (prime >= wanted)
+            {
+                return prime;
+            }
+        }
+        return primes[sizeof(primes) / sizeof(primes[0]) - 1];
+    }
+
+    static size_t next_capacity(size_t capacity)
+    {
+        return round_capacity(capacity + 1);
+    }
+
+    size_t bucket(size_t hash) const
+    {
+        uint32_t folded = static_cast<uint32_t>(static_cast<uint64_t>(hash) ^ (static_cast<uint64_t>(hash) >> 32));
+#if defined(__SIZEOF_INT128__)
+        uint64_t low_bits = multiplier * folded;
+        return static_cast<size_t>((static_cast<unsigned __int128>(low_bits) * divisor) >> 64);
+#else
+        return folded % divisor;
+#endif
+    }
+};
+
+// UNORDERED_MAP_STATS compiles in the event counters reported by stats(): lookups and their probes,
+// inserts that land in an occupied bucket, rehashes and the time they took. Without it every
+// counting statement disappears and stats() only reports what a walk over the table shows.
+#if defined(UNORDERED_MAP_STATS)
+#define UNORDERED_MAP_COUNT(...) __VA_ARGS__
+#else
+#define UNORDERED_MAP_COUNT(...)
+#endif
+
+// snapshot of a map's bucket health, the same fields for every storage engine
+struct UnorderedMapStats
+{
+    size_t size = 0, bucket_count = 0;
+    double load_factor = 0;
+
+    // chained: chain_lengths[n] is the number of buckets holding n elements,
+    // flat: chain_lengths[n] is the number of elements sitting n probe groups past their home group
+    std::vector<size_t> chain_lengths;
+    // longest chain, or furthest probe distance, i.e. the most probes a lookup can take
+    size_t max_probe_length = 0;
+    // elements that share their bucket with another one, or do not sit in their home group
+    size_t collisions = 0;
+
+    // bucket array or control bytes, element storage, and the rest: links, free slots, the map object
+    size_t bucket_bytes = 0, node_bytes = 0, overhead_bytes = 0;
+
+    // event counters, all zero unless built with UNORDERED_MAP_STATS.
+    // A lookup is every probe for a key, including the one an insert does first.
+    bool counters_enabled = false;
+    uint64_t lookups = 0, lookup_probes = 0, max_lookup_probes = 0;
+    uint64_t inserts = 0, insert_collisions = 0;
+    uint64_t rehashes = 0, rehash_nanos = 0;
+
+    double probes_per_lookup() const
+    {
+        return (lookups == 0 ? 0 : static_cast<double>(lookup_probes) / static_cast<double>(lookups));
+    }
+
+    // fn(const std::string &name, double value) once per metric, for pushing into a metrics pipeline
+    template <typename Fn>
+    void export_metrics(Fn &&fn) const;
+};
+
+template <typename Fn>
+void UnorderedMapStats::export_metrics(Fn &&fn) const
+{
+    fn("size", static_cast<double>(size));
+    fn("bucket_count", static_cast<double>(bucket_count));
+    fn("load_factor", load_factor);
+    fn("max_probe_length", static_cast<double>(max_probe_length));
+    fn("collisions", static_cast<double>(collisions));
+    fn("bucket_bytes", static_cast<double>(bucket_bytes));
+    fn("node_bytes", static_cast<double>(node_bytes));
+    fn("overhead_bytes", static_cast<double>(overhead_bytes));
+
+    for (size_t length = 0; length < chain_lengths.size(); length++)
+    {
+        fn("chain_length_" + std::to_string(length), static_cast<double>(chain_lengths[length]));
+    }
+
+    if (counters_enabled)
+    {
+        fn("lookups", static_cast<double>(lookups));
+        fn("probes_per_lookup", probes_per_lookup());
+        fn("max_lookup_probes", static_cast<double>(max_lookup_probes));
+        fn("inserts", static_cast<double>(inserts));
+        fn("insert_collisions", static_cast<double>(insert_collisions));
+        fn("rehashes", static_cast<double>(rehashes));
+        fn("rehash_seconds", static_cast<double>(rehash_nanos) * 1e-9);
+    }
+}
+
+// event counters kept inside a map built with UNORDERED_MAP_STATS. Const lookups of concurrent
+// readers count too, so the counters are relaxed atomics; a copied or moved map starts from zero.
+class MapCounters
+{
+    std::atomic<uint64_t> lookups{0}, lookup_probes{0}, max_lookup_probes{0};
+    std::atomic<uint64_t> inserts{0}, insert_collisions{0};
+    std::atomic<uint64_t> rehashes{0}, rehash_nanos{0};
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    MapCounters() = default;
+
+    MapCounters(const MapCounters &)
+    {
+    }
+
+    MapCounters &operator=(const MapCounters &)
+    {
+        return *this;
+    }
+
+    void record_lookup(uint64_t probes)
+    {
+        lookups.fetch_add(1, std::memory_order_relaxed);
+        lookup_probes.fetch_add(probes, std::memory_order_relaxed);
+
+        uint64_t seen = max_lookup_probes.load(std::memory_order_relaxed);
+        while (seen < probes && !max_lookup_probes.compare_exchange_weak(seen, probes, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void record_insert(bool collided)
+    {
+        inserts.fetch_add(1, std::memory_order_relaxed);
+        if (collided)
+        {
+            insert_collisions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void record_rehash(Clock::time_point started)
+    {
+        rehashes.fetch_add(1, std::memory_order_relaxed);
+        auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started);
+        rehash_nanos.fetch_add(static_cast<uint64_t>(took.count()), std::memory_order_relaxed);
+    }
+
+    void fill(UnorderedMapStats &stats) const
+    {
+        stats.counters_enabled = true;
+        stats.lookups = lookups.load(std::memory_order_relaxed);
+        stats.lookup_probes = lookup_probes.load(std::memory_order_relaxed);
+        stats.max_lookup_probes = max_lookup_probes.load(std::memory_order_relaxed);
+        stats.inserts = inserts.load(std::memory_order_relaxed);
+        stats.insert_collisions = insert_collisions.load(std::memory_order_relaxed);
+        stats.rehashes = rehashes.load(std::memory_order_relaxed);
+        stats.rehash_nanos = rehash_nanos.load(std::memory_order_relaxed);
+    }
+};
+
+// storage engines, picked by the last template parameter of UnorderedMap
+// ChainedStorage - elements live in list nodes, buckets point into the list
+//     CacheHash - every node keeps the full hash of its key, so probing and rehash never call Hash again
+//     Incremental - growing keeps the old bucket array and every insert/erase/find moves a few of its buckets
+//                   to the new one, so no single operation pays for the whole table
+//     IndexPolicy - how a hash is reduced to a bucket, one of the *Index policies above
+// FlatStorage - open addressing over contiguous slots with control bytes (see unordered_map_flat.cpp,
+//               the slot table itself is shared with RobinHoodStorage in unordered_map_open_addressing.cpp)
+// SmallStorage - up to InlineCount elements inside the map object, past that a LargeStorage map
+//                (see unordered_map_small.cpp)
+// RobinHoodStorage - linear probing that keeps runs ordered by probe distance, erase shifts back
+//                    instead of leaving tombstones (see unordered_map_robin_hood.cpp)
+template <bool CacheHash = false, bool Incremental = false, typename IndexPolicy = ModuloIndex>
+struct ChainedStorage
+{
+    static constexpr bool cache_hash = CacheHash;
+    static constexpr bool incremental = Incremental;
+    using Index = IndexPolicy;
+};
+
+struct FlatStorage
+{
+};
+
+struct RobinHoodStorage
+{
+};
+
+template <size_t InlineCount = 8, typename LargeStorage = ChainedStorage<>>
+struct SmallStorage
+{
+    static constexpr size_t inline_count = InlineCount;
+    using Large = LargeStorage;
+};
+
+// list element of the chained engine
+template <typename NodeType, bool CacheHash>
+struct ChainedNode
+{
+    NodeType value;
+    size_t hash;
+
+    template <typename... Args>
+    ChainedNode(size_t full_hash, Args &&...args) : value(std::forward<Args>(args)...), hash(full_hash)
+    {
+    }
+};
+
+template <typename NodeType>
+struct ChainedNode<NodeType, false>
+{
+    NodeType value;
+
+    template <typename... Args>
+    ChainedNode(size_t, Args &&...args) : value(std::forward<Args>(args)...)
+    {
+    }
+};
+
+// key based part of the UnorderedMap interface, written once for every storage engine on top of
+// the primitives the engine provides: find, end, erase(iterator), size, reserve, hash_of(key),
+// bucket_of(hash) and emplace_hashed(key, hash, pair arguments), which probes for key and builds
+// the pair only on a miss. An engine may also replace emplace_detached, the emplace of a pair
+// whose key is not known before the pair exists, and insert_range, bucket_of is only used by the
+// one here.
+template <typename Derived, typename Key, typename Value, bool Transparent>
+class MapFrontEnd
+{
+    Derived &self();
+    const Derived &self() const;
+
+protected:
+    template <typename... Args>
+    auto emplace_detached(Args &&...args);
+
+public:
+    using NodeType = std::pair<Key, Value>;
+
+    // overloads taking any key type exist only for transparent maps, D defers the iterator
+    // types of the engine until the overload is looked at
+    template <typename K, typename R, typename D = Derived>
+    using EnableTransparent = std::enable_if_t<Transparent && !std::is_convertible<K, typename D::Iterator>::value &&
+                                                   !std::is_convertible<K, typename D::ConstIterator>::value,
+                                               R>;
+
+    template <typename U>
+    size_t count(const U &key) const;
+
+    template <typename U>
+    bool contains(const U &key) const;
+
+    Value &operator[](Key &&key);
+    Value &operator[](const Key &key);
+
+    Value &at(Key &&key);
+    Value &at(const Key &key);
+
+    const Value &at(Key &&key) const;
+    const Value &at(const Key &key) const;
+
+    template <typename K, typename D = Derived>
+    EnableTransparent<K, Value &, D> at(const K &key);
+    template <typename K, typename D = Derived>
+    EnableTransparent<K, const Value &, D> at(const K &key) const;
+
+    auto insert(NodeType &&ins_pair);
+    auto insert(const NodeType &ins_pair);
+
+    template <typename InputIt>
+    void insert(InputIt first, InputIt second);
+
+    // forward ranges are measured and the table is sized once before the first insert,
+    // sort_by_bucket inserts in bucket order, so consecutive inserts touch neighbouring memory
+    template <typename InputIt>
+    size_t insert_range(InputIt first, InputIt last, bool sort_by_bucket = false);
+
+    template <typename... Args>
+    auto emplace(Args &&...args);
+
+    template <typename... Args>
+    auto try_emplace(const Key &key, Args &&...args);
+    template <typename... Args>
+    auto try_emplace(Key &&key, Args &&...args);
+    template <typename K, typename... Args, typename D = Derived>
+    auto try_emplace(K &&key, Args &&...args) -> EnableTransparent<K, std::pair<typename D::Iterator, bool>, D>;
+
+    template <typename M>
+    auto insert_or_assign(const Key &key, M &&obj);
+    template <typename M>
+    auto insert_or_assign(Key &&key, M &&obj);
+    template <typename K, typename M, typename D = Derived>
+    auto insert_or_assign(K &&key, M &&obj) -> EnableTransparent<K, std::pair<typename D::Iterator, bool>, D>;
+
+    size_t erase(const Key &key);
+    template <typename K, typename D = Derived>
+    EnableTransparent<K, size_t, D> erase(const K &key);
+};
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+Derived &MapFrontEnd<Derived, Key, Value, Transparent>::self()
+{
+    return static_cast<Derived &>(*this);
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+const Derived &MapFrontEnd<Derived, Key, Value, Transparent>::self() const
+{
+    return static_cast<const Derived &>(*this);
+}
+
+// lookup
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename U>
+size_t MapFrontEnd<Derived, Key, Value, Transparent>::count(const U &key) const
+{
+    return (self().find(key) != self().end() ? 1 : 0);
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename U>
+bool MapFrontEnd<Derived, Key, Value, Transparent>::contains(const U &key) const
+{
+    return self().find(key) != self().end();
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+Value &MapFrontEnd<Derived, Key, Value, Transparent>::operator[](Key &&key)
+{
+    return try_emplace(std::move(key)).first->second;
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+Value &MapFrontEnd<Derived, Key, Value, Transparent>::operator[](const Key &key)
+{
+    return try_emplace(key).first->second;
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+Value &MapFrontEnd<Derived, Key, Value, Transparent>::at(Key &&key)
+{
+    return at(static_cast<const Key &>(key));
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+Value &MapFrontEnd<Derived, Key, Value, Transparent>::at(const Key &key)
+{
+    auto elem_pos = self().find(key);
+
+    if (elem_pos != self().end())
+    {
+        return (*elem_pos).second;
+    }
+
+    throw std::out_of_range("No such key exists!");
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+const Value &MapFrontEnd<Derived, Key, Value, Transparent>::at(Key &&key) const
+{
+    return at(static_cast<const Key &>(key));
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+const Value &MapFrontEnd<Derived, Key, Value, Transparent>::at(const Key &key) const
+{
+    auto elem_pos = self().find(key);
+
+    if (elem_pos != self().end())
+    {
+        return (*elem_pos).second;
+    }
+
+    throw std::out_of_range("No such key exists!");
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename K, typename D>
+typename MapFrontEnd<Derived, Key, Value, Transparent>::template EnableTransparent<K, Value &, D> MapFrontEnd<Derived, Key, Value, Transparent>::at(const K &key)
+{
+    auto elem_pos = self().find(key);
+
+    if (elem_pos != self().end())
+    {
+        return (*elem_pos).second;
+    }
+
+    throw std::out_of_range("No such key exists!");
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename K, typename D>
+typename MapFrontEnd<Derived, Key, Value, Transparent>::template EnableTransparent<K, const Value &, D> MapFrontEnd<Derived, Key, Value, Transparent>::at(const K &key) const
+{
+    auto elem_pos = self().find(key);
+
+    if (elem_pos != self().end())
+    {
+        return (*elem_pos).second;
+    }
+
+    throw std::out_of_range("No such key exists!");
+}
+
+// element insertion/deletion
+template <typename Derived, typename Key, typename Value, bool Transparent>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::insert(NodeType &&ins_pair)
+{
+    return self().emplace_hashed(ins_pair.first, self().hash_of(ins_pair.first), std::move(ins_pair));
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::insert(const NodeType &ins_pair)
+{
+    return self().emplace_hashed(ins_pair.first, self().hash_of(ins_pair.first), ins_pair);
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename InputIt>
+void MapFrontEnd<Derived, Key, Value, Transparent>::insert(InputIt first, InputIt second)
+{
+    self().insert_range(first, second);
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename InputIt>
+size_t MapFrontEnd<Derived, Key, Value, Transparent>::insert_range(InputIt first, InputIt last, bool sort_by_bucket)
+{
+    using Category = typename std::iterator_traits<InputIt>::iterator_category;
+    size_t inserted = 0;
+
+    if constexpr (std::is_convertible<Category, std::forward_iterator_tag>::value)
+    {
+        size_t count = static_cast<size_t>(std::distance(first, last));
+        self().reserve(self().size() + count);
+
+        if (sort_by_bucket)
+        {
+            struct Pending
+            {
+                size_t bucket, hash;
+                InputIt elem;
+            };
+
+            std::vector<Pending> order;
+            order.reserve(count);
+            for (; first != last; ++first)
+            {
+                size_t hash = self().hash_of((*first).first);
+                order.push_back({self().bucket_of(hash), hash, first});
+            }
+
+            // stable, so the first of several equal keys is still the one that is kept
+            std::stable_sort(order.begin(), order.end(), [](const Pending &lhs, const Pending &rhs)
+            {
+                return lhs.bucket < rhs.bucket;
+            });
+
+            for (const Pending &pending : order)
+            {
+                auto &&ins_pair = *pending.elem;
+                inserted += self().emplace_hashed(ins_pair.first, pending.hash, std::forward<decltype(ins_pair)>(ins_pair)).second;
+            }
+            return inserted;
+        }
+    }
+
+    for (; first != last; ++first)
+    {
+        auto &&ins_pair = *first;
+        inserted += self().emplace_hashed(ins_pair.first, self().hash_of(ins_pair.first),
+                                          std::forward<decltype(ins_pair)>(ins_pair)).second;
+    }
+    return inserted;
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename... Args>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::emplace(Args &&...args)
+{
+    if constexpr (sizeof...(Args) == 2)
+    {
+        // (key, mapped) is probed by the key itself before anything is built
+        using First = std::decay_t<std::tuple_element_t<0, std::tuple<Args...>>>;
+        if constexpr (std::is_same<First, Key>::value)
+        {
+            return try_emplace(std::forward<Args>(args)...);
+        }
+        else
+        {
+            return self().emplace_detached(std::forward<Args>(args)...);
+        }
+    }
+    else if constexpr (sizeof...(Args) == 1)
+    {
+        using First = std::decay_t<std::tuple_element_t<0, std::tuple<Args...>>>;
+        if constexpr (std::is_same<First, NodeType>::value || std::is_same<First, std::pair<const Key, Value>>::value)
+        {
+            const auto &ins_pair = (args, ...);
+            return self().emplace_hashed(ins_pair.first, self().hash_of(ins_pair.first), std::forward<Args>(args)...);
+        }
+        else
+        {
+            return self().emplace_detached(std::forward<Args>(args)...);
+        }
+    }
+    else
+    {
+        return self().emplace_detached(std::forward<Args>(args)...);
+    }
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename... Args>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::emplace_detached(Args &&...args)
+{
+    // the key is unknown until the pair exists, it is moved into the table on a miss
+    NodeType tmp(std::forward<Args>(args)...);
+    return self().emplace_hashed(tmp.first, self().hash_of(tmp.first), std::move(tmp));
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename... Args>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::try_emplace(const Key &key, Args &&...args)
+{
+    return self().emplace_hashed(key, self().hash_of(key), std::piecewise_construct, std::forward_as_tuple(key),
+                                 std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename... Args>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::try_emplace(Key &&key, Args &&...args)
+{
+    return self().emplace_hashed(key, self().hash_of(key), std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                                 std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename K, typename... Args, typename D>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::try_emplace(K &&key, Args &&...args) -> EnableTransparent<K, std::pair<typename D::Iterator, bool>, D>
+{
+    // Key is built from the heterogeneous key only when it is really inserted
+    return self().emplace_hashed(key, self().hash_of(key), std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                 std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename M>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::insert_or_assign(const Key &key, M &&obj)
+{
+    auto result = try_emplace(key, std::forward<M>(obj));
+    if (!result.second)
+    {
+        // obj is left untouched by try_emplace when the key already exists
+        result.first->second = std::forward<M>(obj);
+    }
+    return result;
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename M>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::insert_or_assign(Key &&key, M &&obj)
+{
+    auto result = try_emplace(std::move(key), std::forward<M>(obj));
+    if (!result.second)
+    {
+        result.first->second = std::forward<M>(obj);
+    }
+    return result;
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename K, typename M, typename D>
+auto MapFrontEnd<Derived, Key, Value, Transparent>::insert_or_assign(K &&key, M &&obj) -> EnableTransparent<K, std::pair<typename D::Iterator, bool>, D>
+{
+    auto result = try_emplace(std::forward<K>(key), std::forward<M>(obj));
+    if (!result.second)
+    {
+        result.first->second = std::forward<M>(obj);
+    }
+    return result;
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+size_t MapFrontEnd<Derived, Key, Value, Transparent>::erase(const Key &key)
+{
+    auto elem_pos = self().find(key);
+    if (elem_pos == self().end())
+    {
+        return 0;
+    }
+
+    self().erase(elem_pos);
+    return 1;
+}
+
+template <typename Derived, typename Key, typename Value, bool Transparent>
+template <typename K, typename D>
+typename MapFrontEnd<Derived, Key, Value, Transparent>::template EnableTransparent<K, size_t, D> MapFrontEnd<Derived, Key, Value, Transparent>::erase(const K &key)
+{
+    auto elem_pos = self().find(key);
+    if (elem_pos == self().end())
+    {
+        return 0;
+    }
+
+    self().erase(elem_pos);
+    return 1;
+}
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>, typename Alloc = std::allocator<std::pair<const Key, Value>>,
+          typename Storage = ChainedStorage<>>
+class UnorderedMap : private EboHolder<Hash, 0>, private EboHolder<Equal, 1>,
+                     public MapFrontEnd<UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>, Key, Value,
+                                        IsTransparent<Hash>::value && IsTransparent<Equal>::value>
+{
+    using HashHolder = EboHolder<Hash, 0>;
+    using EqualHolder = EboHolder<Equal, 1>;
+    using Front = MapFrontEnd<UnorderedMap, Key, Value, IsTransparent<Hash>::value && IsTransparent<Equal>::value>;
+
+public:
+    static constexpr size_t init_cap = 10;
+    static constexpr double init_load_factor = 0.75d;
+    // old buckets moved by every operation while an incremental rehash is running
+    static constexpr size_t migrate_batch = 4;
+    // keys hashed and prefetched ahead of the chain walks in find_batch/insert_batch
+    static constexpr size_t batch_window = 16;
+
+    using NodeType = std::pair<Key, Value>;
+    using IndexPolicy = typename Storage::Index;
+
+    using StoredNode = ChainedNode<NodeType, Storage::cache_hash>;
+    using NodeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<StoredNode>;
+
+    using ListIterator = typename List<StoredNode, NodeAlloc>::iterator;
+    using ListConstIterator = typename List<StoredNode, NodeAlloc>::const_iterator;
+    using BucketAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<ListIterator>;
+
+    template <bool IsConst>
+    class common_iterator;
+
+    using Iterator = common_iterator<false>;
+    using ConstIterator = common_iterator<true>;
+    using ReverseIterator = std::reverse_iterator<Iterator>;
+    using ConstReverseIterator = std::reverse_iterator<ConstIterator>;
+
+    static constexpr bool transparent = IsTransparent<Hash>::value && IsTransparent<Equal>::value;
+
+    // overloads taking any key type exist only for transparent maps
+    template <typename K, typename R>
+    using EnableTransparent = std::enable_if_t<transparent && !std::is_convertible<K, Iterator>::value &&
+                                                   !std::is_convertible<K, ConstIterator>::value,
+                                               R>;
+
+    Iterator begin();
+    ConstIterator begin() const;
+
+    Iterator end();
+    ConstIterator end() const;
+
+    ConstIterator cbegin() const;
+    ConstIterator cend() const;
+
+    ReverseIterator rbegin();
+    ConstReverseIterator rbegin() const;
+
+    ReverseIterator rend();
+    ConstReverseIterator rend() const;
+
+    ConstReverseIterator crbegin() const;
+    ConstReverseIterator crend() const;
+
+    List<StoredNode, NodeAlloc> data_holder;
+    // first node of every bucket, empty buckets keep a value-initialized iterator
+    std::vector<ListIterator, BucketAlloc> data;
+
+    size_t capacity, curr_size;
+    double max_lf;
+    IndexPolicy index;
+
+    // incremental rehash: nodes of old_data buckets form the tail of data_holder starting at old_begin,
+    // old buckets below migrate_pos are already moved
+    std::vector<ListIterator, BucketAlloc> old_data;
+    ListIterator old_begin;
+    size_t old_cap = 0, migrate_pos = 0;
+    IndexPolicy old_index;
+
+    UNORDERED_MAP_COUNT(mutable MapCounters counters;)
+
+
+    const Hash &hasher() const;
+    const Equal &equality() const;
+
+    template <typename U>
+    size_t get_hash(U &&key) const;
+    template <typename U>
+    size_t hash_of(const U &key) const;
+
+    size_t full_hash(const StoredNode &node) const;
+    size_t bucket_of(size_t hash) const;
+    size_t bucket_of(size_t hash, const IndexPolicy &policy) const;
+
+    template <typename U>
+    std::pair<ListIterator, bool> find_in_run(const U &key, size_t hash, ListIterator head, const IndexPolicy &policy, ListIterator run_end) const;
+
+    template <typename U>
+    std::pair<ListIterator, bool> find_in_bucket(const U &key, size_t hash) const;
+
+    template <typename KeyIt, typename Fn>
+    void resolve_batch(KeyIt first, KeyIt last, Fn &&fn) const;
+
+    bool migrating() const;
+    ListIterator new_end() const;
+    void start_migration(size_t new_cap);
+    void migrate_bucket(size_t old_bucket);
+    void migrate_buckets(size_t amount);
+    void migrate_step();
+
+    template <typename... Args>
+    ListIterator emplace_node(size_t hash, Args &&...args);
+    ListIterator splice_node(size_t hash, List<StoredNode, NodeAlloc> &from, ListIterator node);
+    // takes node out of its bucket, the node itself stays in data_holder
+    void unlink_node(ListConstIterator node);
+    // unlinks and destroys node without a migration step, so a range erase can keep walking the list
+    void erase_node(ListConstIterator node);
+
+    template <typename K>
+    std::pair<ListIterator, bool> probe_insert(const K &key, size_t hash);
+
+    template <typename... Args>
+    std::pair<Iterator, bool> emplace_detached(Args &&...args);
+
+    UnorderedMap();
+    explicit UnorderedMap(size_t bucket_count, const Hash &hash = Hash(), const Equal &equal = Equal(),
+                          const Alloc &alloc = Alloc());
+    explicit UnorderedMap(const Alloc &alloc);
+
+    template <typename InputIt, typename = RequireInputIter<InputIt>>
+    UnorderedMap(InputIt first, InputIt last, size_t bucket_count = init_cap, const Hash &hash = Hash(),
+                 const Equal &equal = Equal(), const Alloc &alloc = Alloc());
+
+    UnorderedMap(const UnorderedMap &other);
+    UnorderedMap(UnorderedMap &&other);
+
+    Hash hash_function() const;
+    Equal key_eq() const;
+    Alloc get_allocator() const;
+
+    size_t size() const;
+
+    double &max_load_factor();
+
+    void max_load_factor(double new_load_factor);
+
+    double load_factor() const;
+
+    void reserve(size_t needed_cap);
+
+    size_t max_size() const;
+
+    // bucket health of the table, walks every node, so it costs O(size + bucket_count)
+    UnorderedMapStats stats() const;
+
+    template <typename U>
+    ConstIterator find_ins_pos(U &&key) const;
+
+    template <typename U>
+    Iterator find_ins_pos(U &&key);
+
+    template <typename K, typename... Args>
+    std::pair<Iterator, bool> emplace_hashed(const K &key, size_t hash, Args &&...node_args);
+
+    using Front::erase;
+    void erase(ConstIterator to_erase);
+    void erase(ConstIterator first, ConstIterator second);
+
+    class NodeHandle;
+    struct InsertReturnType;
+
+    // extract hands the list node of an element over, insert and merge splice nodes back in,
+    // nothing is allocated and keys and values are never moved;
+    // nodes may only travel between maps whose allocators compare equal
+    NodeHandle extract(ConstIterator pos);
+    NodeHandle extract(const Key &key);
+    template <typename K>
+    EnableTransparent<K, NodeHandle> extract(const K &key);
+
+    using Front::insert;
+    InsertReturnType insert(NodeHandle &&handle);
+
+    // keys already present here stay in source
+    template <typename H2, typename E2>
+    void merge(UnorderedMap<Key, Value, H2, E2, Alloc, Storage> &source);
+    template <typename H2, typename E2>
+    void merge(UnorderedMap<Key, Value, H2, E2, Alloc, Storage> &&source);
+
+    size_t capacity_for(size_t new_size) const;
+    bool check_load(size_t new_size);
+    void rehash();
+    void rehash_to(size_t new_cap);
+
+    // parallel relink of the existing nodes into new_cap buckets, optionally followed by inserting
+    // [first, last); Hash, Equal and the allocator get called from several threads at once
+    template <typename Executor, typename RandomIt>
+    size_t parallel_build(size_t new_cap, Executor &&exec, RandomIt first, RandomIt last);
+
+    // bulk load of a random access range spread over exec, returns the number of inserted keys,
+    // the first of several equal keys wins like in insert_range
+    template <typename RandomIt, typename Executor>
+    size_t insert_parallel(RandomIt first, RandomIt last, Executor &&exec);
+
+    template <typename Executor>
+    void rehash(size_t bucket_count, Executor &&exec);
+
+    UnorderedMap &operator=(const UnorderedMap &other);
+    UnorderedMap &operator=(UnorderedMap &&other);
+
+    void swap(UnorderedMap &other);
+
+    template <typename U>
+    Iterator find(U &&key);
+
+    template <typename U>
+    ConstIterator find(U &&key) const;
+
+    // keys come from a forward range, one iterator per key is written to out, end() for misses
+    template <typename KeyIt, typename OutIt>
+    OutIt find_batch(KeyIt first, KeyIt last, OutIt out);
+    template <typename KeyIt, typename OutIt>
+    OutIt find_batch(KeyIt first, KeyIt last, OutIt out) const;
+
+    // pairs come from a forward range, returns the number of inserted keys
+    template <typename InputIt>
+    size_t insert_batch(InputIt first, InputIt last);
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename U>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::get_hash(U &&key) const
+{
+    return bucket_of(hasher()(std::forward<U>(key)));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename U>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::hash_of(const U &key) const
+{
+    return hasher()(key);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+const Hash &UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::hasher() const
+{
+    return HashHolder::get();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+const Equal &UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::equality() const
+{
+    return EqualHolder::get();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+Hash UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::hash_function() const
+{
+    return hasher();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+Equal UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::key_eq() const
+{
+    return equality();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+Alloc UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::get_allocator() const
+{
+    return Alloc(data_holder.get_allocator());
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::full_hash(const StoredNode &node) const
+{
+    if constexpr (Storage::cache_hash)
+    {
+        return node.hash;
+    }
+    else
+    {
+        return hasher()(node.value.first);
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::bucket_of(size_t hash) const
+{
+    return index.bucket(hash);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::bucket_of(size_t hash, const IndexPolicy &policy) const
+{
+    return policy.bucket(hash);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::max_size() const
+{
+    return 357913941;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+double &UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::max_load_factor()
+{
+    return max_lf;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::max_load_factor(double new_load_factor)
+{
+    max_lf = new_load_factor;
+}
 
-template<typename NodeType, typename Alloc>
-using List = std::list<NodeType, Alloc>;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::reserve(size_t needed_capacity)
+{
+    // one relink to the final capacity instead of a rehash per doubling
+    if (capacity * max_lf < needed_capacity)
+    {
+        rehash_to(capacity_for(needed_capacity));
+    }
+}
 
-template <typename Key, typename Value, typename Hash = std::hash<Key>,
-          typename Equal = std::equal_to<Key>, typename Alloc = std::allocator<std::pair<const Key, Value>>>
-class UnorderedMap
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+double UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::load_factor() const
 {
-public:
-    static constexpr size_t init_cap = 10;
-    static constexpr double init_load_factor = 0.75d;
+    return (static_cast<double>(curr_size) / static_cast<double>(capacity));
+}
 
-    using NodeType = std::pair<Key, Value>;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+UnorderedMapStats UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::stats() const
+{
+    UnorderedMapStats result;
+    result.size = curr_size;
+    result.bucket_count = capacity;
+    result.load_factor = load_factor();
+    result.chain_lengths.assign(1, 0);
+
+    // every bucket is one run of consecutive nodes, during an incremental rehash the nodes
+    // from old_begin on still form the runs of the old buckets
+    size_t new_runs = 0, run_length = 0, run_bucket = 0;
+    const IndexPolicy *policy = &index;
+    ListConstIterator old_region = new_end();
+
+    auto close_run = [&result, &run_length]()
+    {
+        if (run_length == 0)
+        {
+            return;
+        }
+        if (result.chain_lengths.size() <= run_length)
+        {
+            result.chain_lengths.resize(run_length + 1, 0);
+        }
+        ++result.chain_lengths[run_length];
+        result.max_probe_length = std::max(result.max_probe_length, run_length);
+        result.collisions += run_length - 1;
+        run_length = 0;
+    };
 
-    using Iterator = typename List<NodeType, Alloc>::iterator;
-    using ConstIterator = typename List<NodeType, Alloc>::const_iterator;
-    using ReverseIterator = typename List<NodeType, Alloc>::reverse_iterator;
-    using ConstReverseIterator = typename List<NodeType, Alloc>::const_reverse_iterator;
+    for (auto iter = data_holder.begin(); iter != data_holder.end(); ++iter)
+    {
+        if (iter == old_region)
+        {
+            close_run();
+            policy = &old_index;
+        }
 
-    Iterator begin();
-    ConstIterator begin() const;
+        size_t bucket = bucket_of(full_hash(*iter), *policy);
+        if (run_length == 0 || bucket != run_bucket)
+        {
+            close_run();
+            run_bucket = bucket;
+            new_runs += (policy == &index);
+        }
+        ++run_length;
+    }
+    close_run();
 
-    Iterator end();
-    ConstIterator end() const;
+    result.chain_lengths[0] = capacity - new_runs;
 
-    ConstIterator cbegin() const;
-    ConstIterator cend() const;
+    result.bucket_bytes = (data.capacity() + old_data.capacity()) * sizeof(ListIterator);
+    result.node_bytes = curr_size * sizeof(StoredNode);
+    // two links per list node and the map object itself
+    result.overhead_bytes = curr_size * 2 * sizeof(void *) + sizeof(*this);
 
-    ReverseIterator rbegin();
-    ConstReverseIterator rbegin() const;
+    UNORDERED_MAP_COUNT(counters.fill(result);)
+    return result;
+}
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::size() const
+{
+    return curr_size;
+}
 
-    ReverseIterator rend();
-    ConstReverseIterator rend() const;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::begin()
+{
+    return data_holder.begin();
+}
 
-    ConstReverseIterator crbegin() const;
-    ConstReverseIterator crend() const;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::begin() const
+{
+    return data_holder.begin();
+}
 
-    List<NodeType, Alloc> data_holder;
-    std::vector<Iterator> data;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::end()
+{
+    return data_holder.end();
+}
 
-    size_t capacity, curr_size;
-    double max_lf;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::end() const
+{
+    return data_holder.end();
+}
 
-    template <typename U>
-    size_t get_hash(U &&key) const;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::cbegin() const
+{
+    return data_holder.cbegin();
+}
 
-    UnorderedMap();
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::cend() const
+{
+    return data_holder.cend();
+}
 
-    UnorderedMap(const UnorderedMap &other);
-    UnorderedMap(UnorderedMap &&other);
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::rbegin()
+{
+    return ReverseIterator(end());
+}
 
-    size_t size() const;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::rbegin() const
+{
+    return crbegin();
+}
 
-    double &max_load_factor();
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::rend()
+{
+    return ReverseIterator(begin());
+}
 
-    void max_load_factor(double new_load_factor);
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::rend() const
+{
+    return crend();
+}
 
-    double load_factor() const;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::crbegin() const
+{
+    return ConstReverseIterator(cend());
+}
 
-    void reserve(size_t needed_cap);
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::crend() const
+{
+    return ConstReverseIterator(cbegin());
+}
 
-    size_t max_size() const;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename... Args>
+std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::Iterator, bool> UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::emplace_detached(Args &&...args)
+{
+    // the key is unknown until the pair exists, so the node is built in a one element list
+    // and spliced in on a miss, on a hit it is freed with the list
+    List<StoredNode, NodeAlloc> detached(data_holder.get_allocator());
+    detached.emplace_back(0, std::forward<Args>(args)...);
+
+    ListIterator node = detached.begin();
+    size_t hash = hasher()(node->value.first);
+    if constexpr (Storage::cache_hash)
+    {
+        node->hash = hash;
+    }
 
-    template <typename U>
-    ConstIterator find_ins_pos(U &&key) const;
+    auto ins_pos = probe_insert(node->value.first, hash);
+    if (ins_pos.second)
+    {
+        return std::make_pair(Iterator(ins_pos.first), false);
+    }
 
-    template <typename U>
-    Iterator find_ins_pos(U &&key);
+    ListIterator new_node = splice_node(hash, detached, node);
+    ++curr_size;
 
-    std::pair<Iterator, bool> insert(NodeType &&ins_pair);
-    std::pair<Iterator, bool> insert(const NodeType &ins_pair);
+    return std::make_pair(Iterator(new_node), true);
+}
 
-    void erase(ConstIterator to_erase);
-    void erase(ConstIterator first, ConstIterator second);
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename KeyIt, typename Fn>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::resolve_batch(KeyIt first, KeyIt last, Fn &&fn) const
+{
+    size_t hashes[batch_window], buckets[batch_window];
+    WindowKeys<Key, transparent, KeyIt, batch_window> keys;
 
-    template <typename InputIt>
-    void insert(InputIt first, InputIt second);
+    while (first != last)
+    {
+        // hash the whole window first, so the bucket slot misses overlap
+        size_t count = 0;
+        for (KeyIt iter = first; iter != last && count < batch_window; ++iter, ++count)
+        {
+            const auto &lookup = keys.load(count, iter);
+            hashes[count] = hasher()(lookup);
+            buckets[count] = bucket_of(hashes[count]);
+            prefetch_read(&data[buckets[count]]);
+        }
 
-    void check_load();
-    void rehash();
+        // the slots are on their way, now the first node of every chain
+        for (size_t i = 0; i < count; i++)
+        {
+            ListIterator head = data[buckets[i]];
+            if (head != ListIterator())
+            {
+                prefetch_read(&*head);
+            }
+        }
 
-    UnorderedMap &operator=(const UnorderedMap &other);
-    UnorderedMap &operator=(UnorderedMap &&other);
+        for (size_t i = 0; i < count; ++i, ++first)
+        {
+            fn(find_in_bucket(keys.get(i, first), hashes[i]));
+        }
+    }
+}
 
-    void swap(UnorderedMap &other);
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename KeyIt, typename OutIt>
+OutIt UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find_batch(KeyIt first, KeyIt last, OutIt out)
+{
+    migrate_step();
 
-    template <typename U>
-    Iterator find(U &&key);
+    resolve_batch(first, last, [this, &out](std::pair<ListIterator, bool> pos)
+    {
+        *out = (pos.second ? Iterator(pos.first) : end());
+        ++out;
+    });
+    return out;
+}
 
-    template <typename U>
-    ConstIterator find(U &&key) const;
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename KeyIt, typename OutIt>
+OutIt UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find_batch(KeyIt first, KeyIt last, OutIt out) const
+{
+    resolve_batch(first, last, [this, &out](std::pair<ListIterator, bool> pos)
+    {
+        *out = (pos.second ? ConstIterator(ListConstIterator(pos.first)) : end());
+        ++out;
+    });
+    return out;
+}
 
-    Value &operator[](Key &&key);
-    Value &operator[](const Key &key);
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename InputIt>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::insert_batch(InputIt first, InputIt last)
+{
+    size_t hashes[batch_window], inserted = 0;
 
-    Value &at(Key &&key);
-    Value &at(const Key &key);
+    while (first != last)
+    {
+        size_t count = 0;
+        for (InputIt iter = first; iter != last && count < batch_window; ++iter, ++count)
+        {
+            hashes[count] = hasher()((*iter).first);
+        }
 
-    const Value &at(Key &&key) const;
-    const Value &at(const Key &key) const;
+        // grow once for the whole window, a rehash in the middle would waste the prefetches
+        check_load(curr_size + count);
+        for (size_t i = 0; i < count; i++)
+        {
+            prefetch_read(&data[bucket_of(hashes[i])]);
+        }
 
-    template <typename... Args>
-    std::pair<Iterator, bool> emplace(Args &&...args);
-};
+        for (size_t i = 0; i < count; ++i, ++first)
+        {
+            inserted += emplace_hashed((*first).first, hashes[i], *first).second;
+        }
+    }
+    return inserted;
+}
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-template <typename U>
-size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::get_hash(U &&key) const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::swap(UnorderedMap &copy)
 {
-    return (Hash{}(std::forward<U>(key)) % capacity);
+    // once every old node is moved old_begin is the list sentinel, which stays with its list
+    bool old_at_end = migrating() && old_begin == data_holder.end();
+    bool copy_old_at_end = copy.migrating() && copy.old_begin == copy.data_holder.end();
+
+    std::swap(static_cast<HashHolder &>(*this), static_cast<HashHolder &>(copy));
+    std::swap(static_cast<EqualHolder &>(*this), static_cast<EqualHolder &>(copy));
+    std::swap(data_holder, copy.data_holder);
+    std::swap(data, copy.data);
+    std::swap(curr_size, copy.curr_size);
+    std::swap(capacity, copy.capacity);
+    std::swap(max_lf, copy.max_lf);
+    std::swap(old_data, copy.old_data);
+    std::swap(old_begin, copy.old_begin);
+    std::swap(old_cap, copy.old_cap);
+    std::swap(migrate_pos, copy.migrate_pos);
+    std::swap(index, copy.index);
+    std::swap(old_index, copy.old_index);
+
+    if (copy_old_at_end)
+    {
+        old_begin = data_holder.end();
+    }
+    if (old_at_end)
+    {
+        copy.old_begin = copy.data_holder.end();
+    }
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::max_size() const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage> &UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::operator=(const UnorderedMap &other)
 {
-    return 357913941;
+
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    UnorderedMap copy(other);
+
+    swap(copy);
+
+    return *this;
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-double &UnorderedMap<Key, Value, Hash, Equal, Alloc>::max_load_factor()
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage> &UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::operator=(UnorderedMap &&other)
 {
-    return max_lf;
+
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    UnorderedMap copy(std::move(other));
+
+    swap(copy);
+
+    return *this;
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::max_load_factor(double new_load_factor)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::unlink_node(ListConstIterator node)
 {
-    max_lf = new_load_factor;
+    size_t hash = full_hash(*node);
+
+    // a key lives in the old table exactly while its old bucket is not migrated yet
+    bool in_old = migrating() && old_data[bucket_of(hash, old_index)] != ListIterator();
+
+    const IndexPolicy &policy = (in_old ? old_index : index);
+    size_t erased_hash = bucket_of(hash, policy);
+    ListIterator &head = (in_old ? old_data[erased_hash] : data[erased_hash]);
+    ListIterator run_end = (in_old ? data_holder.end() : new_end());
+
+    if (head == node)
+    {
+        auto curr_iter = head;
+        ++curr_iter;
+        if (curr_iter != run_end && bucket_of(full_hash(*curr_iter), policy) == erased_hash)
+        {
+            ++head;
+        }
+        else
+        {
+            head = ListIterator();
+        }
+    }
+
+    if (migrating() && old_begin == node)
+    {
+        ++old_begin;
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::erase_node(ListConstIterator node)
+{
+    unlink_node(node);
+    data_holder.erase(node);
+    --curr_size;
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::reserve(size_t needed_capacity)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::erase(ConstIterator to_erase)
 {
-    while (capacity * max_lf < needed_capacity)
+    erase_node(to_erase.base());
+
+    migrate_step();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::erase(ConstIterator first, ConstIterator second)
+{
+
+    // a migration step splices nodes around, it only runs once the range is gone
+    ConstIterator copy(first);
+    while (first != second)
     {
-        rehash();
+        ++first;
+        erase_node(copy.base());
+        copy = first;
     }
+
+    migrate_step();
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-double UnorderedMap<Key, Value, Hash, Equal, Alloc>::load_factor() const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::UnorderedMap() : UnorderedMap(init_cap)
 {
-    return (static_cast<double>(curr_size) / static_cast<double>(capacity));
 }
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-size_t UnorderedMap<Key, Value, Hash, Equal, Alloc>::size() const
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::UnorderedMap(size_t bucket_count, const Hash &hash, const Equal &equal, const Alloc &alloc)
+    : HashHolder(hash), EqualHolder(equal), data_holder(NodeAlloc(alloc)),
+      data(IndexPolicy::round_capacity(bucket_count), ListIterator(), BucketAlloc(alloc)),
+      capacity(IndexPolicy::round_capacity(bucket_count)), curr_size(0), max_lf(init_load_factor), index(capacity),
+      old_data(BucketAlloc(alloc))
 {
-    return curr_size;
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::begin()
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::UnorderedMap(const Alloc &alloc) : UnorderedMap(init_cap, Hash(), Equal(), alloc)
 {
-    return data_holder.begin();
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::begin() const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename InputIt, typename>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::UnorderedMap(InputIt first, InputIt last, size_t bucket_count, const Hash &hash,
+                                                                    const Equal &equal, const Alloc &alloc)
+    : UnorderedMap(bucket_count, hash, equal, alloc)
 {
-    return data_holder.begin();
+    this->insert_range(first, last);
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::end()
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::UnorderedMap(const UnorderedMap &other)
+    : HashHolder(other.hasher()), EqualHolder(other.equality()),
+      data_holder(std::allocator_traits<NodeAlloc>::select_on_container_copy_construction(other.data_holder.get_allocator())),
+      data(other.capacity, ListIterator(), BucketAlloc(data_holder.get_allocator())), capacity(other.capacity), curr_size(0),
+      max_lf(other.max_lf), index(other.index), old_data(BucketAlloc(data_holder.get_allocator()))
 {
-    return data_holder.end();
+    // keys of other are already unique, only the bucket heads have to be rebuilt
+    auto iter = other.data_holder.begin();
+    auto end_iter = other.data_holder.end();
+
+    while (iter != end_iter)
+    {
+        emplace_node(other.full_hash(*iter), iter->value);
+        ++curr_size;
+        ++iter;
+    }
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::end() const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::UnorderedMap(UnorderedMap &&other) : HashHolder(other.hasher()), EqualHolder(other.equality()),
+                                                                                            data_holder(std::move(other.data_holder)), data(std::move(other.data)),
+                                                                                            capacity(other.capacity), curr_size(other.curr_size),
+                                                                                            max_lf(other.max_lf), index(other.index)
 {
-    return data_holder.end();
+    std::swap(old_data, other.old_data);
+    std::swap(old_begin, other.old_begin);
+    std::swap(old_cap, other.old_cap);
+    std::swap(migrate_pos, other.migrate_pos);
+    std::swap(old_index, other.old_index);
+
+    // the list sentinel stayed with other, an old_begin pointing at it has to follow the nodes
+    if (migrating() && old_begin == other.data_holder.end())
+    {
+        old_begin = data_holder.end();
+    }
+
+    other.max_lf = init_load_factor;
+    other.capacity = IndexPolicy::round_capacity(init_cap);
+    other.curr_size = 0;
+    other.index = IndexPolicy(other.capacity);
+    other.data.assign(other.capacity, ListIterator());
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename U>
+std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ListIterator, bool> UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find_in_run(const U &key, size_t hash, ListIterator head, const IndexPolicy &policy, ListIterator run_end) const
+{
+
+    size_t elem_hash = bucket_of(hash, policy);
+    UNORDERED_MAP_COUNT(size_t probes = 0;)
+
+    ListIterator iter = head;
+    if (iter == ListIterator())
+    {
+        UNORDERED_MAP_COUNT(counters.record_lookup(probes);)
+        return std::make_pair(iter, false);
+    }
+
+    while (iter != run_end)
+    {
+        UNORDERED_MAP_COUNT(++probes;)
+        if constexpr (Storage::cache_hash)
+        {
+            if (iter->hash == hash && equality()(iter->value.first, key))
+            {
+                UNORDERED_MAP_COUNT(counters.record_lookup(probes);)
+                return std::make_pair(iter, true);
+            }
+        }
+        else
+        {
+            if (equality()(iter->value.first, key))
+            {
+                UNORDERED_MAP_COUNT(counters.record_lookup(probes);)
+                return std::make_pair(iter, true);
+            }
+        }
+
+        ++iter;
+        if (iter != run_end && bucket_of(full_hash(*iter), policy) != elem_hash)
+        {
+            break;
+        }
+    }
+
+    UNORDERED_MAP_COUNT(counters.record_lookup(probes);)
+    return std::make_pair(iter, false);
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::cbegin() const
-{
-    return data_holder.cbegin();
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename U>
+std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ListIterator, bool> UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find_in_bucket(const U &key, size_t hash) const
+{
+    if (migrating())
+    {
+        ListIterator old_head = old_data[bucket_of(hash, old_index)];
+        if (old_head != ListIterator())
+        {
+            // data_holder is only read here, the iterator is handed back to non-const callers
+            return find_in_run(key, hash, old_head, old_index, const_cast<List<StoredNode, NodeAlloc> &>(data_holder).end());
+        }
+    }
+
+    return find_in_run(key, hash, data[bucket_of(hash)], index, new_end());
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::cend() const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename U>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find_ins_pos(U &&key) const
 {
-    return data_holder.cend();
+    const auto &lookup = lookup_key<Key, transparent>(key);
+    auto pos = find_in_bucket(lookup, hasher()(lookup));
+    if (pos.first == ListIterator())
+    {
+        return end();
+    }
+    return ConstIterator(ListConstIterator(pos.first));
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::rbegin()
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename U>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find_ins_pos(U &&key)
 {
-    return data_holder.rbegin();
+    const auto &lookup = lookup_key<Key, transparent>(key);
+    auto pos = find_in_bucket(lookup, hasher()(lookup));
+    if (pos.first == ListIterator())
+    {
+        return end();
+    }
+    return Iterator(pos.first);
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::rbegin() const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename U>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find(U &&key)
 {
-    return data_holder.rbegin();
-}
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::rend()
-{
-    return data_holder.rend();
+    migrate_step();
+
+    const auto &lookup = lookup_key<Key, transparent>(key);
+    auto pos = find_in_bucket(lookup, hasher()(lookup));
+
+    if (pos.second)
+    {
+        return Iterator(pos.first);
+    }
+    else
+    {
+        return end();
+    }
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::rend() const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename U>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::find(U &&key) const
 {
-    return data_holder.rend();
+
+    const auto &lookup = lookup_key<Key, transparent>(key);
+    auto pos = find_in_bucket(lookup, hasher()(lookup));
+
+    if (pos.second)
+    {
+        return ConstIterator(ListConstIterator(pos.first));
+    }
+    else
+    {
+        return end();
+    }
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::crbegin() const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename... Args>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ListIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::emplace_node(size_t hash, Args &&...args)
 {
-    return data_holder.crbegin();
+    // the new node becomes the head of its bucket, so no walk along the bucket is needed
+    size_t key_hash = bucket_of(hash);
+    ListIterator ins_pos = (data[key_hash] == ListIterator() ? new_end() : data[key_hash]);
+    UNORDERED_MAP_COUNT(counters.record_insert(data[key_hash] != ListIterator());)
+
+    data[key_hash] = data_holder.emplace(ins_pos, hash, std::forward<Args>(args)...);
+    return data[key_hash];
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstReverseIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::crend() const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ListIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::splice_node(size_t hash, List<StoredNode, NodeAlloc> &from, ListIterator node)
 {
-    return data_holder.crend();
+    size_t key_hash = bucket_of(hash);
+    ListIterator ins_pos = (data[key_hash] == ListIterator() ? new_end() : data[key_hash]);
+    UNORDERED_MAP_COUNT(counters.record_insert(data[key_hash] != ListIterator());)
+
+    data_holder.splice(ins_pos, from, node);
+    data[key_hash] = node;
+    return node;
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-template <typename... Args>
-std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::Iterator, bool> UnorderedMap<Key, Value, Hash, Equal, Alloc>::emplace(Args &&...args)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K>
+std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ListIterator, bool> UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::probe_insert(const K &key, size_t hash)
 {
 
-    using Tmp = typename std::allocator_traits<Alloc>::template rebind_alloc<NodeType>;
-    using Tr = typename std::allocator_traits<Tmp>;
+    migrate_step();
 
-    Tmp my_alloc(data_holder.get_allocator());
+    auto ins_pos = find_in_bucket(key, hash);
 
-    auto ptr = Tr::allocate(my_alloc, 1);
-    Tr::construct(my_alloc, ptr, std::forward<Args>(args)...);
+    if (ins_pos.second)
+    {
+        return ins_pos;
+    }
 
-    auto result = insert(std::move(*ptr));
+    // the table is grown before the new node exists, so a miss costs a single probe
+    check_load(curr_size + 1);
 
-    if (result.second)
+    // new keys always go to the new table, so their old bucket has to be moved first
+    if (migrating())
     {
-        return result;
+        migrate_bucket(bucket_of(hash, old_index));
     }
 
-    Tr::destroy(my_alloc, ptr);
-    Tr::deallocate(my_alloc, ptr, 1);
-
-    return result;
+    return ins_pos;
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-const Value &UnorderedMap<Key, Value, Hash, Equal, Alloc>::at(Key &&key) const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K, typename... Args>
+std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::Iterator, bool> UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::emplace_hashed(const K &key, size_t hash, Args &&...node_args)
 {
+    auto ins_pos = probe_insert(key, hash);
 
-    auto elem_pos = find(std::move(key));
-
-    if (elem_pos != end())
+    if (ins_pos.second)
     {
-        return (*elem_pos).second;
+        return std::make_pair(Iterator(ins_pos.first), false);
     }
 
-    throw std::out_of_range("No such key exists!");
+    // the pair is built only on a miss and after the probe, so node_args may still refer to key
+    ListIterator new_node = emplace_node(hash, std::forward<Args>(node_args)...);
+    ++curr_size;
+
+    return std::make_pair(Iterator(new_node), true);
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-const Value &UnorderedMap<Key, Value, Hash, Equal, Alloc>::at(const Key &key) const
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::capacity_for(size_t new_size) const
 {
-
-    auto elem_pos = find(key);
-
-    if (elem_pos != end())
+    // smallest capacity of the index policy that holds new_size elements under max_lf
+    size_t new_cap = IndexPolicy::round_capacity(static_cast<size_t>(static_cast<double>(new_size) / max_lf) + 1);
+    while (new_cap * max_lf < new_size && IndexPolicy::next_capacity(new_cap) != new_cap)
     {
-        return (*elem_pos).second;
+        new_cap = IndexPolicy::next_capacity(new_cap);
     }
-
-    throw std::out_of_range("No such key exists!");
+    return new_cap;
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-Value &UnorderedMap<Key, Value, Hash, Equal, Alloc>::at(Key &&key)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+bool UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::check_load(size_t new_size)
 {
+    if (capacity * max_lf >= new_size)
+    {
+        return false;
+    }
 
-    auto elem_pos = find(std::move(key));
+    size_t new_cap = IndexPolicy::next_capacity(capacity);
+    while (new_cap * max_lf < new_size && IndexPolicy::next_capacity(new_cap) != new_cap)
+    {
+        new_cap = IndexPolicy::next_capacity(new_cap);
+    }
 
-    if (elem_pos != end())
+    if constexpr (Storage::incremental)
     {
-        return (*elem_pos).second;
+        start_migration(new_cap);
+    }
+    else
+    {
+        rehash_to(new_cap);
     }
+    return true;
+}
 
-    throw std::out_of_range("No such key exists!");
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::rehash()
+{
+    rehash_to(IndexPolicy::next_capacity(capacity));
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-Value &UnorderedMap<Key, Value, Hash, Equal, Alloc>::at(const Key &key)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename Executor, typename RandomIt>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::parallel_build(size_t new_cap, Executor &&exec, RandomIt first, RandomIt last)
 {
+    using NodeList = List<StoredNode, NodeAlloc>;
 
-    auto elem_pos = find(key);
+    migrate_buckets(old_cap);
+    UNORDERED_MAP_COUNT(auto rehash_started = MapCounters::Clock::now();)
+
+    size_t tasks = std::max<size_t>(1, exec.concurrency());
+    size_t input_size = static_cast<size_t>(last - first);
+    IndexPolicy new_index(new_cap);
 
-    if (elem_pos != end())
+    // task t owns the buckets [new_cap * t / tasks, new_cap * (t + 1) / tasks)
+    auto owner_of = [tasks, new_cap](size_t bucket)
     {
-        return (*elem_pos).second;
+        return static_cast<size_t>(static_cast<unsigned long long>(bucket) * tasks / new_cap);
+    };
+
+    // the existing nodes are dealt out in equal chunks, one per splitting task
+    NodeList proto(data_holder.get_allocator());
+    std::vector<NodeList> chunks(tasks, proto), parts(tasks * tasks, proto);
+    size_t chunk_len = (curr_size + tasks - 1) / tasks;
+    for (size_t chunk = 0; chunk < tasks && !data_holder.empty(); chunk++)
+    {
+        auto split = data_holder.begin();
+        std::advance(split, std::min(chunk_len, data_holder.size()));
+        chunks[chunk].splice(chunks[chunk].end(), data_holder, data_holder.begin(), split);
     }
 
-    throw std::out_of_range("No such key exists!");
-}
-
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-Value &UnorderedMap<Key, Value, Hash, Equal, Alloc>::operator[](Key &&key)
-{
+    // split: chunk c sorts its nodes and its share of the input by owner into parts[c * tasks + owner],
+    // every list and vector here is written by one task only
+    std::vector<std::vector<size_t>> node_buckets(tasks * tasks), pending(tasks * tasks);
+    std::vector<size_t> hashes(input_size), buckets(input_size);
+    std::vector<NodeList> owned(tasks, proto);
+    std::vector<size_t> inserted(tasks, 0);
 
-    auto elem_pos = find(std::move(key));
+    try
+    {
+        exec(tasks, [&](size_t chunk)
+        {
+            NodeList &source = chunks[chunk];
+            while (!source.empty())
+            {
+                ListIterator node = source.begin();
+                size_t bucket = new_index.bucket(full_hash(*node));
+                size_t owner = owner_of(bucket);
+
+                parts[chunk * tasks + owner].splice(parts[chunk * tasks + owner].end(), source, node);
+                node_buckets[chunk * tasks + owner].push_back(bucket);
+            }
+
+            size_t input_begin = input_size * chunk / tasks, input_end = input_size * (chunk + 1) / tasks;
+            for (size_t elem = input_begin; elem < input_end; elem++)
+            {
+                hashes[elem] = hasher()(first[elem].first);
+                buckets[elem] = new_index.bucket(hashes[elem]);
+                pending[chunk * tasks + owner_of(buckets[elem])].push_back(elem);
+            }
+        });
+
+        capacity = new_cap;
+        index = new_index;
+        data.assign(capacity, ListIterator());
+
+        // merge: every owner relinks and inserts into its own bucket range and its own list,
+        // chunks are visited in order, so earlier input keeps precedence
+        exec(tasks, [&](size_t owner)
+        {
+            NodeList &target = owned[owner];
+
+            for (size_t chunk = 0; chunk < tasks; chunk++)
+            {
+                NodeList &source = parts[chunk * tasks + owner];
+                for (size_t bucket : node_buckets[chunk * tasks + owner])
+                {
+                    ListIterator node = source.begin();
+                    target.splice(data[bucket] == ListIterator() ? target.end() : data[bucket], source, node);
+                    data[bucket] = node;
+                }
+            }
+
+            for (size_t chunk = 0; chunk < tasks; chunk++)
+            {
+                for (size_t elem : pending[chunk * tasks + owner])
+                {
+                    size_t bucket = buckets[elem];
+                    if (find_in_run(first[elem].first, hashes[elem], data[bucket], index, target.end()).second)
+                    {
+                        continue;
+                    }
+
+                    ListIterator ins_pos = (data[bucket] == ListIterator() ? target.end() : data[bucket]);
+                    data[bucket] = target.emplace(ins_pos, hashes[elem], first[elem]);
+                    ++inserted[owner];
+                }
+            }
+        });
+    }
+    catch (...)
+    {
+        // every node, old or already inserted, goes back into the map and the buckets are rebuilt
+        for (NodeList &nodes : chunks)
+        {
+            data_holder.splice(data_holder.end(), nodes);
+        }
+        for (NodeList &nodes : parts)
+        {
+            data_holder.splice(data_holder.end(), nodes);
+        }
+        for (NodeList &nodes : owned)
+        {
+            data_holder.splice(data_holder.end(), nodes);
+        }
+        curr_size = data_holder.size();
+        rehash_to(capacity);
+        throw;
+    }
 
-    if (elem_pos != end())
+    size_t total = 0;
+    for (size_t owner = 0; owner < tasks; owner++)
     {
-        return (*elem_pos).second;
+        data_holder.splice(data_holder.end(), owned[owner]);
+        total += inserted[owner];
     }
+    curr_size += total;
+
+    UNORDERED_MAP_COUNT(counters.record_rehash(rehash_started);)
 
-    insert(std::make_pair(key, Value()));
-    return (*this)[std::move(key)];
+    return total;
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-Value &UnorderedMap<Key, Value, Hash, Equal, Alloc>::operator[](const Key &key)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename RandomIt, typename Executor>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::insert_parallel(RandomIt first, RandomIt last, Executor &&exec)
 {
+    size_t needed = curr_size + static_cast<size_t>(last - first);
+    size_t new_cap = (capacity * max_lf < needed ? capacity_for(needed) : capacity);
+    return parallel_build(new_cap, exec, first, last);
+}
 
-    auto elem_pos = find(key);
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename Executor>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::rehash(size_t bucket_count, Executor &&exec)
+{
+    size_t new_cap = std::max(IndexPolicy::round_capacity(bucket_count), capacity_for(curr_size));
+    const NodeType *no_input = nullptr;
+    parallel_build(new_cap, exec, no_input, no_input);
+}
 
-    if (elem_pos != end())
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+bool UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::migrating() const
+{
+    if constexpr (Storage::incremental)
     {
-        return (*elem_pos).second;
+        return !old_data.empty();
+    }
+    else
+    {
+        return false;
     }
-
-    insert(std::make_pair(key, Value()));
-    return (*this)[key];
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::swap(UnorderedMap &copy)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::ListIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::new_end() const
 {
-    std::swap(data_holder, copy.data_holder);
-    std::swap(data, copy.data);
-    std::swap(curr_size, copy.curr_size);
-    std::swap(capacity, copy.capacity);
-    std::swap(max_lf, copy.max_lf);
+    if (migrating())
+    {
+        return old_begin;
+    }
+    // data_holder is only read here, the iterator is handed back to non-const callers
+    return const_cast<List<StoredNode, NodeAlloc> &>(data_holder).end();
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Value, Hash, Equal, Alloc> &UnorderedMap<Key, Value, Hash, Equal, Alloc>::operator=(const UnorderedMap &other)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::start_migration(size_t new_cap)
 {
+    // a previous migration is still running only if the table grew again very quickly
+    migrate_buckets(old_cap);
+    UNORDERED_MAP_COUNT(auto rehash_started = MapCounters::Clock::now();)
+
+    old_data.swap(data);
+    data.assign(new_cap, ListIterator());
+
+    old_begin = data_holder.begin();
+    old_cap = capacity;
+    old_index = index;
+    migrate_pos = 0;
+    capacity = new_cap;
+    index = IndexPolicy(new_cap);
+
+    // only the switch is timed, the moves are spread over later operations
+    UNORDERED_MAP_COUNT(counters.record_rehash(rehash_started);)
+}
 
-    if (this == &other)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::migrate_bucket(size_t old_bucket)
+{
+    ListIterator node = old_data[old_bucket];
+    if (node == ListIterator())
     {
-        return *this;
+        return;
     }
 
-    UnorderedMap copy(other);
+    while (node != data_holder.end() && bucket_of(full_hash(*node), old_index) == old_bucket)
+    {
+        ListIterator next = node;
+        ++next;
 
-    swap(copy);
+        if (node == old_begin)
+        {
+            old_begin = next;
+        }
 
-    return *this;
-}
+        size_t hash = full_hash(*node);
+        size_t key_hash = bucket_of(hash);
+        ListIterator ins_pos = (data[key_hash] == ListIterator() ? old_begin : data[key_hash]);
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Value, Hash, Equal, Alloc> &UnorderedMap<Key, Value, Hash, Equal, Alloc>::operator=(UnorderedMap &&other)
-{
+        data_holder.splice(ins_pos, data_holder, node);
+        data[key_hash] = node;
 
-    if (this == &other)
-    {
-        return *this;
+        node = next;
     }
 
-    UnorderedMap copy(std::move(other));
-
-    swap(copy);
-
-    return *this;
+    old_data[old_bucket] = ListIterator();
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-template <typename InputIt>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::insert(InputIt first, InputIt second)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::migrate_buckets(size_t amount)
 {
-
-    while (first != second)
+    if (!migrating())
     {
-        insert(*first);
-        ++first;
+        return;
     }
-}
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::erase(ConstIterator to_erase)
-{
-
-    size_t erased_hash = get_hash(to_erase->first);
-
-    if (Equal{}(data[erased_hash]->first, to_erase->first))
+    for (; amount > 0 && migrate_pos < old_cap; --amount)
     {
-        auto curr_iter = data[erased_hash];
-        ++curr_iter;
-        if (curr_iter != end() && get_hash(curr_iter->first) == erased_hash)
-        {
-            ++data[erased_hash];
-        }
-        else
-        {
-            data[erased_hash] = end();
-        }
+        migrate_bucket(migrate_pos++);
     }
 
-    data_holder.erase(to_erase);
-    --curr_size;
+    if (migrate_pos == old_cap)
+    {
+        std::vector<ListIterator, BucketAlloc>(old_data.get_allocator()).swap(old_data);
+        old_begin = ListIterator();
+        old_cap = 0;
+        migrate_pos = 0;
+    }
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::erase(ConstIterator first, ConstIterator second)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::migrate_step()
 {
-
-    ConstIterator copy(first);
-    while (first != second)
+    if constexpr (Storage::incremental)
     {
-        ++first;
-        erase(copy);
-        copy = first;
+        migrate_buckets(migrate_batch);
     }
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap() : data_holder(), data(init_cap, data_holder.end()), capacity(init_cap), curr_size(0),
-                                                               max_lf(init_load_factor)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::rehash_to(size_t new_cap)
 {
-}
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap(const UnorderedMap &other) : data_holder(), data(other.capacity, data_holder.end()), capacity(other.capacity), curr_size(0),
-                                                                                        max_lf(other.max_lf)
-{
-    auto iter = other.begin();
-    auto end_iter = other.end();
+    migrate_buckets(old_cap);
+    UNORDERED_MAP_COUNT(auto rehash_started = MapCounters::Clock::now();)
 
-    while (iter != end_iter)
+    // nodes are relinked into their new buckets, nothing is allocated, moved or copied
+    // and iterators to the elements stay valid
+    List<StoredNode, NodeAlloc> old_data_holder(data_holder.get_allocator());
+    old_data_holder.splice(old_data_holder.end(), data_holder);
+
+    capacity = new_cap;
+    index = IndexPolicy(new_cap);
+    data.assign(capacity, ListIterator());
+
+    while (!old_data_holder.empty())
     {
-        insert(*iter);
-        ++iter;
+        ListIterator node = old_data_holder.begin();
+        size_t key_hash = bucket_of(full_hash(*node));
+        ListIterator ins_pos = (data[key_hash] == ListIterator() ? data_holder.end() : data[key_hash]);
+
+        data_holder.splice(ins_pos, old_data_holder, node);
+        data[key_hash] = node;
     }
-}
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-UnorderedMap<Key, Value, Hash, Equal, Alloc>::UnorderedMap(UnorderedMap &&other) : data_holder(std::move(other.data_holder)), data(std::move(other.data)),
-                                                                                   capacity(other.capacity), curr_size(other.curr_size),
-                                                                                   max_lf(other.max_lf)
-{
-    other.max_lf = init_load_factor;
-    other.capacity = init_cap;
-    other.curr_size = 0;
+    UNORDERED_MAP_COUNT(counters.record_rehash(rehash_started);)
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-template <typename U>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::find_ins_pos(U &&key) const
+// iterator
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <bool IsConst>
+class UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::common_iterator
 {
+    std::conditional_t<IsConst, ListConstIterator, ListIterator> iter;
 
-    size_t elem_hash = get_hash(key);
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = NodeType;
+    using pointer = std::conditional_t<IsConst, const NodeType *, NodeType *>;
+    using reference = std::conditional_t<IsConst, const NodeType &, NodeType &>;
+    using difference_type = std::ptrdiff_t;
 
-    ConstIterator iter = data[elem_hash];
-    ConstIterator end_iter = end();
+    common_iterator() = default;
 
-    while (iter != end_iter && (get_hash((*iter).first) == elem_hash))
+    common_iterator(std::conditional_t<IsConst, ListConstIterator, ListIterator> list_iter) : iter(list_iter)
     {
-        if (Equal{}((*iter).first, key))
-        {
-            return iter;
-        }
-        ++iter;
     }
 
-    return iter;
-}
+    common_iterator(const common_iterator<false> &other) : iter(other.base())
+    {
+    }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-template <typename U>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::find_ins_pos(U &&key)
-{
+    common_iterator &operator=(const common_iterator &other) = default;
 
-    size_t elem_hash = get_hash(key);
+    std::conditional_t<IsConst, ListConstIterator, ListIterator> base() const
+    {
+        return iter;
+    }
 
-    Iterator iter = data[elem_hash];
-    Iterator end_iter = end();
+    reference operator*() const
+    {
+        return iter->value;
+    }
 
-    while (iter != end_iter && (get_hash((*iter).first) == elem_hash))
+    pointer operator->() const
+    {
+        return &iter->value;
+    }
+
+    common_iterator &operator++()
     {
-        if (Equal{}((*iter).first, key))
-        {
-            return iter;
-        }
         ++iter;
+        return *this;
     }
 
-    return iter;
-}
+    common_iterator operator++(int)
+    {
+        auto copy = *this;
+        ++iter;
+        return copy;
+    }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-template <typename U>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::find(U &&key)
-{
+    common_iterator &operator--()
+    {
+        --iter;
+        return *this;
+    }
 
-    Iterator iter = find_ins_pos(key);
+    common_iterator operator--(int)
+    {
+        auto copy = *this;
+        --iter;
+        return copy;
+    }
 
-    std::cerr.flush();
-    if (iter != end() && Equal{}((*iter).first, key))
+    bool operator==(const common_iterator &other) const
     {
-        return iter;
+        return iter == other.iter;
     }
-    else
+
+    bool operator!=(const common_iterator &other) const
     {
-        return end();
+        return !(*this == other);
     }
-}
+};
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-template <typename U>
-typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc>::find(U &&key) const
+// node handle
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+class UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::NodeHandle
 {
+    // empty or holding the one extracted node
+    List<StoredNode, NodeAlloc> holder;
+
+    explicit NodeHandle(const NodeAlloc &alloc) : holder(alloc)
+    {
+    }
+
+    friend class UnorderedMap;
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using allocator_type = Alloc;
 
-    ConstIterator iter = find_ins_pos(key);
+    NodeHandle() = default;
 
-    std::cerr.flush();
-    if (iter != end() && Equal{}((*iter).first, key))
+    NodeHandle(NodeHandle &&other) : holder(std::move(other.holder))
     {
-        return iter;
+        other.holder.clear();
     }
-    else
+
+    NodeHandle &operator=(NodeHandle &&other)
     {
-        return end();
+        holder = std::move(other.holder);
+        other.holder.clear();
+        return *this;
     }
-}
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::Iterator, bool> UnorderedMap<Key, Value, Hash, Equal, Alloc>::insert(NodeType &&ins_pair)
-{
+    NodeHandle(const NodeHandle &other) = delete;
+    NodeHandle &operator=(const NodeHandle &other) = delete;
 
-    auto ins_pos = find_ins_pos(ins_pair.first);
-    bool is_found = ((ins_pos != end()) && Equal{}(ins_pair.first, (*ins_pos).first));
+    bool empty() const
+    {
+        return holder.empty();
+    }
+
+    explicit operator bool() const
+    {
+        return !empty();
+    }
 
-    size_t key_hash = get_hash(ins_pair.first);
+    // the key may be changed before the node is inserted again
+    Key &key()
+    {
+        return holder.front().value.first;
+    }
 
-    if (!is_found)
+    const Key &key() const
     {
+        return holder.front().value.first;
+    }
 
-        data_holder.insert(ins_pos, std::move(ins_pair));
-        ++curr_size;
+    Value &mapped()
+    {
+        return holder.front().value.second;
+    }
 
-        if (data[key_hash] == end())
-        {
-            --data[key_hash];
-        }
+    const Value &mapped() const
+    {
+        return holder.front().value.second;
+    }
 
-        check_load();
-        return std::make_pair(ins_pos, true);
+    Alloc get_allocator() const
+    {
+        return Alloc(holder.get_allocator());
     }
+};
 
-    return std::make_pair(ins_pos, false);
-}
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+struct UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::InsertReturnType
+{
+    Iterator position;
+    bool inserted;
+    NodeHandle node;
+};
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc>::Iterator, bool> UnorderedMap<Key, Value, Hash, Equal, Alloc>::insert(const NodeType &ins_pair)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::NodeHandle UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::extract(ConstIterator pos)
 {
+    NodeHandle handle(data_holder.get_allocator());
 
-    auto ins_pos = find_ins_pos(ins_pair.first);
-    bool is_found = ((ins_pos != end()) && Equal{}(ins_pair.first, (*ins_pos).first));
+    unlink_node(pos.base());
+    handle.holder.splice(handle.holder.end(), data_holder, pos.base());
+    --curr_size;
 
-    size_t key_hash = get_hash(ins_pair.first);
+    migrate_step();
+    return handle;
+}
 
-    if (!is_found)
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::NodeHandle UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::extract(const Key &key)
+{
+    auto elem_pos = find(key);
+    if (elem_pos == end())
     {
+        return NodeHandle(data_holder.get_allocator());
+    }
 
-        data_holder.insert(ins_pos, ins_pair);
-        ++curr_size;
-
-        if (data[key_hash] == end())
-        {
-            --data[key_hash];
-        }
+    return extract(ConstIterator(elem_pos));
+}
 
-        check_load();
-        return std::make_pair(ins_pos, true);
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename K>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::template EnableTransparent<K, typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::NodeHandle> UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::extract(const K &key)
+{
+    auto elem_pos = find(key);
+    if (elem_pos == end())
+    {
+        return NodeHandle(data_holder.get_allocator());
     }
 
-    return std::make_pair(ins_pos, false);
+    return extract(ConstIterator(elem_pos));
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::check_load()
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::InsertReturnType UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::insert(NodeHandle &&handle)
 {
-    if (capacity * max_lf < curr_size)
+    if (handle.empty())
+    {
+        return InsertReturnType{end(), false, std::move(handle)};
+    }
+
+    // the key may have been changed through the handle, so the cached hash is not trusted
+    ListIterator node = handle.holder.begin();
+    size_t hash = hasher()(node->value.first);
+
+    auto ins_pos = probe_insert(node->value.first, hash);
+    if (ins_pos.second)
+    {
+        return InsertReturnType{Iterator(ins_pos.first), false, std::move(handle)};
+    }
+
+    if constexpr (Storage::cache_hash)
     {
-        rehash();
+        node->hash = hash;
     }
+
+    splice_node(hash, handle.holder, node);
+    ++curr_size;
+
+    return InsertReturnType{Iterator(node), true, NodeHandle(data_holder.get_allocator())};
 }
 
-template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
-void UnorderedMap<Key, Value, Hash, Equal, Alloc>::rehash()
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename H2, typename E2>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::merge(UnorderedMap<Key, Value, H2, E2, Alloc, Storage> &source)
 {
+    if (static_cast<const void *>(&source) == this || source.curr_size == 0)
+    {
+        return;
+    }
 
-    List<NodeType, Alloc> new_data_holder;
-    std::vector<Iterator> new_data(capacity << 1, new_data_holder.end());
+    // the buckets of source are rebuilt once at the end instead of being fixed per moved node
+    source.migrate_buckets(source.old_cap);
+    reserve(curr_size + source.curr_size);
 
-    std::swap(data, new_data);
-    std::swap(data_holder, new_data_holder);
+    // a cached hash is only reused when both maps hash the same way
+    constexpr bool same_hash = Storage::cache_hash && std::is_same<Hash, H2>::value && std::is_empty<Hash>::value;
 
-    curr_size = 0;
-    capacity <<= 1;
+    size_t moved = 0;
+    try
+    {
+        ListIterator node = source.data_holder.begin();
+        while (node != source.data_holder.end())
+        {
+            ListIterator next = node;
+            ++next;
+
+            size_t hash = (same_hash ? source.full_hash(*node) : hasher()(node->value.first));
+            auto ins_pos = probe_insert(node->value.first, hash);
+            if (!ins_pos.second)
+            {
+                if constexpr (Storage::cache_hash)
+                {
+                    node->hash = hash;
+                }
+
+                splice_node(hash, source.data_holder, node);
+                ++curr_size;
+                --source.curr_size;
+                ++moved;
+            }
+
+            node = next;
+        }
+    }
+    catch (...)
+    {
+        source.rehash_to(source.capacity);
+        throw;
+    }
 
-    for (auto iter = new_data_holder.begin(); iter != new_data_holder.end(); ++iter)
+    if (moved != 0)
     {
-        insert(std::forward<NodeType>(*iter));
+        source.rehash_to(source.capacity);
     }
+}
 
-    check_load();
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+template <typename H2, typename E2>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage>::merge(UnorderedMap<Key, Value, H2, E2, Alloc, Storage> &&source)
+{
+    merge(source);
 }
 
+#include "unordered_map_open_addressing.cpp"
+#include "unordered_map_flat.cpp"
+#include "unordered_map_small.cpp"
+#include "unordered_map_robin_hood.cpp"
 
+#endif // UNORDERED_MAP_CPP
@@ -0,0 +1,91 @@
+
+#include "unordered_map.cpp"
+
+#include <chrono>
+#include <random>
+#include <string>
+
+// per key cost of a find loop against find_batch, and of an insert loop against insert_batch,
+// on tables growing past the caches
+// usage: UnorderedMapBatchBench [max_elements]
+
+template <typename Func>
+double measure_ns(size_t ops, Func &&func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count() / static_cast<double>(ops);
+}
+
+template <typename Storage>
+void run_storage(const char *name, const std::vector<std::pair<uint64_t, uint64_t>> &pairs, const std::vector<uint64_t> &probes)
+{
+    using BenchMap = UnorderedMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                                  std::allocator<std::pair<const uint64_t, uint64_t>>, Storage>;
+    uint64_t sink = 0;
+
+    BenchMap loop_map;
+    double insert_ns = measure_ns(pairs.size(), [&]()
+    {
+        for (const auto &pair : pairs)
+        {
+            loop_map.insert(pair);
+        }
+    });
+
+    BenchMap batch_map;
+    double insert_batch_ns = measure_ns(pairs.size(), [&]()
+    {
+        batch_map.insert_batch(pairs.begin(), pairs.end());
+    });
+
+    double find_ns = measure_ns(probes.size(), [&]()
+    {
+        for (uint64_t key : probes)
+        {
+            auto pos = loop_map.find(key);
+            sink += (pos == loop_map.end() ? 0 : pos->second);
+        }
+    });
+
+    std::vector<typename BenchMap::Iterator> found(probes.size());
+    double find_batch_ns = measure_ns(probes.size(), [&]()
+    {
+        batch_map.find_batch(probes.begin(), probes.end(), found.begin());
+        for (auto pos : found)
+        {
+            sink += (pos == batch_map.end() ? 0 : pos->second);
+        }
+    });
+
+    std::cout << name << "\t" << pairs.size() << "\t" << insert_ns << "\t" << insert_batch_ns << "\t" << find_ns
+              << "\t" << find_batch_ns << "\t(" << sink % 10 << ")\n";
+}
+
+int main(int argc, char **argv)
+{
+
+    size_t max_elements = (argc > 1 ? std::stoull(argv[1]) : 10000000);
+
+    std::cout << "storage\tsize\tinsert ns\tinsert_batch ns\tfind ns\tfind_batch ns\n";
+
+    std::mt19937_64 rng(7);
+    for (size_t elements = 10000; elements <= max_elements; elements *= 10)
+    {
+        std::vector<std::pair<uint64_t, uint64_t>> pairs(elements);
+        std::vector<uint64_t> probes(elements);
+        for (size_t i = 0; i < elements; i++)
+        {
+            pairs[i] = {rng(), i};
+        }
+        // half hits, half misses
+        for (size_t i = 0; i < elements; i++)
+        {
+            probes[i] = (i % 2 == 0 ? pairs[rng() % elements].first : rng());
+        }
+
+        run_storage<ChainedStorage<true>>("chained", pairs, probes);
+        run_storage<FlatStorage>("flat", pairs, probes);
+    }
+}
@@ -0,0 +1,596 @@
+#include "unordered_map.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// benchmark suite of UnorderedMap against std::unordered_map: insert, hit and miss lookups, erase,
+// iteration, rehash and an 80/10/10 find/insert/erase mix, for uint64_t, std::string and 64 byte
+// keys, lookups under uniform and Zipfian access. Every result is one line of the table on stdout
+// and, with --json, one entry of a google-benchmark shaped JSON file, so runs of different
+// commits can be compared with the usual tools.
+// usage: UnorderedMapBench [--min-size=100] [--max-size=1000000] [--min-ops=1048576]
+//                          [--filter=substring] [--json=path] [--label=text]
+// sizes go from min-size to max-size in steps of 10, 1e8 works given the memory for it
+
+struct Key64
+{
+    uint64_t words[8];
+
+    bool operator==(const Key64 &other) const
+    {
+        for (size_t i = 0; i < 8; i++)
+        {
+            if (words[i] != other.words[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct Key64Hash
+{
+    size_t operator()(const Key64 &key) const
+    {
+        uint64_t hash = 0;
+        for (size_t i = 0; i < 8; i++)
+        {
+            hash = mix_hash_bits(hash ^ key.words[i]);
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+template <typename KeyType>
+struct KeyTraits;
+
+template <>
+struct KeyTraits<uint64_t>
+{
+    using Hash = std::hash<uint64_t>;
+    static constexpr const char *name = "u64";
+
+    static uint64_t make(uint64_t bits)
+    {
+        return bits;
+    }
+};
+
+template <>
+struct KeyTraits<std::string>
+{
+    using Hash = std::hash<std::string>;
+    static constexpr const char *name = "string";
+
+    static std::string make(uint64_t bits)
+    {
+        // 20 characters, past the small string buffer
+        char text[24];
+        std::snprintf(text, sizeof(text), "key-%016llx", static_cast<unsigned long long>(bits));
+        return text;
+    }
+};
+
+template <>
+struct KeyTraits<Key64>
+{
+    using Hash = Key64Hash;
+    static constexpr const char *name = "key64";
+
+    static Key64 make(uint64_t bits)
+    {
+        Key64 key;
+        for (size_t i = 0; i < 8; i++)
+        {
+            key.words[i] = bits ^ (i * 0x9E3779B97F4A7C15ull);
+        }
+        return key;
+    }
+};
+
+// Zipf distributed ranks 0 .. n - 1 by rejection-inversion (Hoermann, Derflinger),
+// constant memory whatever n, so it scales to the largest tables
+class ZipfGenerator
+{
+    double exponent;
+    double size;
+    double h_integral_x1, h_integral_n, threshold;
+
+    static double helper1(double x)
+    {
+        return (std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x)));
+    }
+
+    static double helper2(double x)
+    {
+        return (std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x)));
+    }
+
+    double h(double x) const
+    {
+        return std::exp(-exponent * std::log(x));
+    }
+
+    double h_integral(double x) const
+    {
+        double log_x = std::log(x);
+        return helper2((1 - exponent) * log_x) * log_x;
+    }
+
+    double h_integral_inverse(double x) const
+    {
+        double t = std::max(-1.0, x * (1 - exponent));
+        return std::exp(helper1(t) * x);
+    }
+
+public:
+    ZipfGenerator(size_t elements, double skew = 0.99)
+        : exponent(skew), size(static_cast<double>(elements)), h_integral_x1(h_integral(1.5) - 1),
+          h_integral_n(h_integral(size + 0.5)), threshold(2 - h_integral_inverse(h_integral(2.5) - h(2)))
+    {
+    }
+
+    template <typename Rng>
+    size_t operator()(Rng &rng)
+    {
+        std::uniform_real_distribution<double> unit(0, 1);
+        while (true)
+        {
+            double u = h_integral_n + unit(rng) * (h_integral_x1 - h_integral_n);
+            double x = h_integral_inverse(u);
+            double k = std::min(size, std::max(1.0, std::floor(x + 0.5)));
+            if (k - x <= threshold || u >= h_integral(k + 0.5) - h(k))
+            {
+                return static_cast<size_t>(k) - 1;
+            }
+        }
+    }
+};
+
+struct BenchOptions
+{
+    size_t min_size = 100, max_size = 1000000, min_ops = 1 << 20;
+    std::string filter, json_path, label;
+};
+
+struct BenchResult
+{
+    std::string name, op, map, key, distribution;
+    size_t size, ops;
+    double ns_per_op;
+};
+
+enum MixedOp : uint8_t
+{
+    mixed_find,
+    mixed_insert,
+    mixed_erase
+};
+
+// keys of one size, lookup patterns are indices into keys
+template <typename KeyType>
+struct Workload
+{
+    std::vector<KeyType> keys, misses;
+    std::vector<uint32_t> uniform, zipf, erase_order;
+    std::vector<uint8_t> mixed_ops;
+
+    Workload(size_t elements, size_t ops, std::mt19937_64 &rng)
+    {
+        // hits have the top bit clear and misses have it set, so the two sets never meet
+        keys.reserve(elements);
+        misses.reserve(ops);
+        for (size_t i = 0; i < elements; i++)
+        {
+            keys.push_back(KeyTraits<KeyType>::make(rng() >> 1));
+        }
+        for (size_t i = 0; i < ops; i++)
+        {
+            misses.push_back(KeyTraits<KeyType>::make(rng() | 1ull << 63));
+        }
+
+        ZipfGenerator zipf_gen(elements);
+        std::uniform_int_distribution<size_t> any_key(0, elements - 1);
+        std::uniform_int_distribution<int> percent(0, 99);
+        for (size_t i = 0; i < ops; i++)
+        {
+            uniform.push_back(static_cast<uint32_t>(any_key(rng)));
+            zipf.push_back(static_cast<uint32_t>(zipf_gen(rng)));
+
+            int roll = percent(rng);
+            mixed_ops.push_back(roll < 80 ? mixed_find : (roll < 90 ? mixed_insert : mixed_erase));
+        }
+
+        for (size_t i = 0; i < elements; i++)
+        {
+            erase_order.push_back(static_cast<uint32_t>(i));
+        }
+        std::shuffle(erase_order.begin(), erase_order.end(), rng);
+    }
+
+    const std::vector<uint32_t> &pattern(const std::string &distribution) const
+    {
+        return (distribution == "zipf" ? zipf : uniform);
+    }
+};
+
+// doubling the bucket count, each map type has its own way
+template <typename... Args>
+void grow(std::unordered_map<Args...> &map)
+{
+    map.rehash(map.bucket_count() * 2);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void grow(UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage> &map)
+{
+    map.rehash();
+}
+
+template <typename Func>
+double measure_ns(Func &&func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count();
+}
+
+class BenchRunner
+{
+    const BenchOptions &options;
+    std::vector<BenchResult> results;
+    uint64_t sink = 0;
+
+public:
+    explicit BenchRunner(const BenchOptions &opts) : options(opts)
+    {
+    }
+
+    const std::vector<BenchResult> &all_results() const
+    {
+        return results;
+    }
+
+    uint64_t checksum() const
+    {
+        return sink;
+    }
+
+    template <typename Map, typename KeyType>
+    void run_map(const char *map_name, const Workload<KeyType> &work);
+
+private:
+    bool selected(const std::string &name) const
+    {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    static std::string bench_name(const std::string &op, const char *map_name, const char *key_name,
+                                  const std::string &distribution, size_t size)
+    {
+        return op + "/" + map_name + "/" + key_name + "/" + distribution + "/" + std::to_string(size);
+    }
+
+    // runs measure(record) when the benchmark passes the filter, measure returns the total ns
+    // and the number of operations it timed
+    template <typename Measure>
+    void bench(const std::string &op, const char *map_name, const char *key_name, const std::string &distribution,
+               size_t size, Measure &&measure);
+};
+
+template <typename Measure>
+void BenchRunner::bench(const std::string &op, const char *map_name, const char *key_name,
+                        const std::string &distribution, size_t size, Measure &&measure)
+{
+    std::string name = bench_name(op, map_name, key_name, distribution, size);
+    if (!selected(name))
+    {
+        return;
+    }
+
+    std::pair<double, size_t> timed = measure();
+    double ns_per_op = timed.first / static_cast<double>(std::max<size_t>(1, timed.second));
+    results.push_back(BenchResult{name, op, map_name, key_name, distribution, size, timed.second, ns_per_op});
+
+    std::cout << name << "\t" << ns_per_op << "\t" << 1e3 / ns_per_op << std::endl;
+}
+
+template <typename Map, typename KeyType>
+void BenchRunner::run_map(const char *map_name, const Workload<KeyType> &work)
+{
+    const char *key_name = KeyTraits<KeyType>::name;
+    const std::vector<KeyType> &keys = work.keys;
+    size_t size = keys.size();
+    size_t ops = work.uniform.size();
+    // small tables are rebuilt until at least min_ops elements went through them
+    size_t reps = std::max<size_t>(1, options.min_ops / size);
+
+    auto build = [&keys](Map &map)
+    {
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            map.insert({keys[i], i});
+        }
+    };
+
+    bench("insert", map_name, key_name, "uniform", size, [&]()
+    {
+        double total_ns = 0;
+        for (size_t rep = 0; rep < reps; rep++)
+        {
+            Map map;
+            total_ns += measure_ns([&]()
+            {
+                build(map);
+            });
+            sink += map.size();
+        }
+        return std::make_pair(total_ns, reps * size);
+    });
+
+    Map filled;
+    build(filled);
+
+    for (const std::string distribution : {"uniform", "zipf"})
+    {
+        const std::vector<uint32_t> &pattern = work.pattern(distribution);
+        bench("find_hit", map_name, key_name, distribution, size, [&]()
+        {
+            double total_ns = measure_ns([&]()
+            {
+                for (uint32_t ind : pattern)
+                {
+                    sink += filled.find(keys[ind])->second;
+                }
+            });
+            return std::make_pair(total_ns, ops);
+        });
+    }
+
+    bench("find_miss", map_name, key_name, "uniform", size, [&]()
+    {
+        double total_ns = measure_ns([&]()
+        {
+            for (const KeyType &key : work.misses)
+            {
+                sink += (filled.find(key) == filled.end());
+            }
+        });
+        return std::make_pair(total_ns, ops);
+    });
+
+    bench("iterate", map_name, key_name, "uniform", size, [&]()
+    {
+        double total_ns = measure_ns([&]()
+        {
+            for (size_t rep = 0; rep < reps; rep++)
+            {
+                for (const auto &elem : filled)
+                {
+                    sink += elem.second;
+                }
+            }
+        });
+        return std::make_pair(total_ns, reps * size);
+    });
+
+    bench("rehash", map_name, key_name, "uniform", size, [&]()
+    {
+        double total_ns = 0;
+        for (size_t rep = 0; rep < reps; rep++)
+        {
+            Map copy(filled);
+            total_ns += measure_ns([&]()
+            {
+                grow(copy);
+            });
+            sink += copy.size();
+        }
+        return std::make_pair(total_ns, reps * size);
+    });
+
+    for (const std::string distribution : {"uniform", "zipf"})
+    {
+        const std::vector<uint32_t> &pattern = work.pattern(distribution);
+        bench("mixed", map_name, key_name, distribution, size, [&]()
+        {
+            Map map;
+            build(map);
+            double total_ns = measure_ns([&]()
+            {
+                for (size_t i = 0; i < ops; i++)
+                {
+                    const KeyType &key = keys[pattern[i]];
+                    switch (work.mixed_ops[i])
+                    {
+                    case mixed_find:
+                    {
+                        auto pos = map.find(key);
+                        sink += (pos == map.end() ? 0 : pos->second);
+                        break;
+                    }
+                    case mixed_insert:
+                        sink += map.insert({key, i}).second;
+                        break;
+                    default:
+                        sink += map.erase(key);
+                        break;
+                    }
+                }
+            });
+            return std::make_pair(total_ns, ops);
+        });
+    }
+
+    bench("erase", map_name, key_name, "uniform", size, [&]()
+    {
+        double total_ns = 0;
+        for (size_t rep = 0; rep < reps; rep++)
+        {
+            Map map;
+            build(map);
+            total_ns += measure_ns([&]()
+            {
+                for (uint32_t ind : work.erase_order)
+                {
+                    sink += map.erase(keys[ind]);
+                }
+            });
+        }
+        return std::make_pair(total_ns, reps * size);
+    });
+}
+
+template <typename KeyType>
+void run_key_type(BenchRunner &runner, const BenchOptions &options, std::mt19937_64 &rng)
+{
+    using Hash = typename KeyTraits<KeyType>::Hash;
+    using Equal = std::equal_to<KeyType>;
+    using Alloc = std::allocator<std::pair<const KeyType, size_t>>;
+
+    for (size_t size = options.min_size; size <= options.max_size; size *= 10)
+    {
+        Workload<KeyType> work(size, options.min_ops, rng);
+
+        runner.run_map<std::unordered_map<KeyType, size_t, Hash, Equal, Alloc>>("std", work);
+        runner.run_map<UnorderedMap<KeyType, size_t, Hash, Equal, Alloc>>("chained", work);
+        runner.run_map<UnorderedMap<KeyType, size_t, Hash, Equal, Alloc, ChainedStorage<true, false, MaskIndex>>>("chained_mask", work);
+        runner.run_map<UnorderedMap<KeyType, size_t, Hash, Equal, Alloc, FlatStorage>>("flat", work);
+        runner.run_map<UnorderedMap<KeyType, size_t, Hash, Equal, Alloc, RobinHoodStorage>>("robin_hood", work);
+        // only differs from chained below the inline count, e.g. with --min-size=8
+        runner.run_map<UnorderedMap<KeyType, size_t, Hash, Equal, Alloc, SmallStorage<8>>>("small", work);
+    }
+}
+
+std::string json_escape(const std::string &text)
+{
+    std::string escaped;
+    for (char symbol : text)
+    {
+        if (symbol == '"' || symbol == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += symbol;
+    }
+    return escaped;
+}
+
+void write_json(const std::string &path, const BenchOptions &options, const std::vector<BenchResult> &results)
+{
+    std::ofstream out(path);
+
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    // the configuration comes from CMake, a build outside of it only knows about NDEBUG
+#if defined(UNORDERED_MAP_BUILD_TYPE)
+    const char *build_type = UNORDERED_MAP_BUILD_TYPE;
+#elif defined(NDEBUG)
+    const char *build_type = "unknown (NDEBUG)";
+#else
+    const char *build_type = "unknown";
+#endif
+
+    out << "{\n  \"context\": {\n";
+    out << "    \"date\": \"" << date << "\",\n";
+    out << "    \"label\": \"" << json_escape(options.label) << "\",\n";
+    out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "    \"library_build_type\": \"" << build_type << "\",\n";
+    out << "    \"min_ops\": " << options.min_ops << "\n";
+    out << "  },\n  \"benchmarks\": [\n";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &result = results[i];
+        out << "    {\"name\": \"" << json_escape(result.name) << "\", \"run_type\": \"iteration\""
+            << ", \"op\": \"" << result.op << "\", \"map\": \"" << result.map << "\", \"key\": \"" << result.key
+            << "\", \"distribution\": \"" << result.distribution << "\", \"size\": " << result.size
+            << ", \"iterations\": " << result.ops << ", \"real_time\": " << result.ns_per_op
+            << ", \"cpu_time\": " << result.ns_per_op << ", \"time_unit\": \"ns\""
+            << ", \"items_per_second\": " << 1e9 / result.ns_per_op << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+
+    if (!out)
+    {
+        std::cerr << "cannot write " << path << "\n";
+    }
+}
+
+bool parse_option(const std::string &arg, const std::string &name, std::string &value)
+{
+    std::string prefix = "--" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0)
+    {
+        return false;
+    }
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i], value;
+        if (parse_option(arg, "min-size", value))
+        {
+            options.min_size = std::max<size_t>(1, std::stoull(value));
+        }
+        else if (parse_option(arg, "max-size", value))
+        {
+            options.max_size = std::stoull(value);
+        }
+        else if (parse_option(arg, "min-ops", value))
+        {
+            options.min_ops = std::max<size_t>(1, std::stoull(value));
+        }
+        else if (parse_option(arg, "filter", value))
+        {
+            options.filter = value;
+        }
+        else if (parse_option(arg, "json", value))
+        {
+            options.json_path = value;
+        }
+        else if (parse_option(arg, "label", value))
+        {
+            options.label = value;
+        }
+        else
+        {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "benchmark\tns/op\tMops/s\n";
+
+    std::mt19937_64 rng(42);
+    BenchRunner runner(options);
+    run_key_type<uint64_t>(runner, options, rng);
+    run_key_type<std::string>(runner, options, rng);
+    run_key_type<Key64>(runner, options, rng);
+
+    if (!options.json_path.empty())
+    {
+        write_json(options.json_path, options, runner.all_results());
+    }
+
+    std::cout << "(" << runner.checksum() % 10 << ")\n";
+}
@@ -0,0 +1,304 @@
+// Flat storage engine for UnorderedMap (included from unordered_map.cpp)
+//
+// Keys and values live in one contiguous array of slots. Every slot has a control byte:
+// negative values mark empty/deleted slots, non-negative ones keep 7 bits of the hash (h2).
+// Lookup probes groups of 16 control bytes at once and only compares keys whose h2 matches.
+// The slot arrays, iterators and growth are shared with Robin Hood (unordered_map_open_addressing.cpp).
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum FlatCtrl : int8_t
+{
+    flat_empty = -128,
+    flat_deleted = -2,
+    flat_sentinel = -1
+};
+
+// 16 control bytes probed together, bit i of a mask stands for slot i of the group
+struct FlatGroup
+{
+    static constexpr size_t width = 16;
+
+#if defined(__SSE2__)
+    __m128i ctrl;
+
+    explicit FlatGroup(const int8_t *pos) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pos)))
+    {
+    }
+
+    uint32_t match(int8_t h2) const
+    {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+    }
+
+    uint32_t match_empty() const
+    {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(flat_empty), ctrl)));
+    }
+
+    uint32_t match_empty_or_deleted() const
+    {
+        // both are below flat_sentinel, full slots are not
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(flat_sentinel), ctrl)));
+    }
+#else
+    int8_t ctrl[width];
+
+    explicit FlatGroup(const int8_t *pos)
+    {
+        std::memcpy(ctrl, pos, width);
+    }
+
+    uint32_t match(int8_t h2) const
+    {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < width; i++)
+        {
+            mask |= static_cast<uint32_t>(ctrl[i] == h2) << i;
+        }
+        return mask;
+    }
+
+    uint32_t match_empty() const
+    {
+        return match(flat_empty);
+    }
+
+    uint32_t match_empty_or_deleted() const
+    {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < width; i++)
+        {
+            mask |= static_cast<uint32_t>(ctrl[i] < flat_sentinel) << i;
+        }
+        return mask;
+    }
+#endif
+
+    static size_t lowest(uint32_t mask)
+    {
+        return static_cast<size_t>(__builtin_ctz(mask));
+    }
+};
+
+// control bytes as seen by OpenAddressingTable
+struct FlatMeta
+{
+    using type = int8_t;
+
+    static constexpr int8_t empty = flat_empty;
+    static constexpr int8_t sentinel = flat_sentinel;
+
+    static bool is_free(int8_t ctrl)
+    {
+        return ctrl < flat_sentinel;
+    }
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+class UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>
+    : public OpenAddressingTable<UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>, Key, Value, Hash, Equal, Alloc, FlatMeta>
+{
+    using Table = OpenAddressingTable<UnorderedMap, Key, Value, Hash, Equal, Alloc, FlatMeta>;
+    friend Table;
+
+public:
+    static constexpr size_t init_cap = FlatGroup::width;
+    static constexpr double init_load_factor = 0.875d;
+
+    using Table::Table;
+
+    template <typename InputIt, typename = RequireInputIter<InputIt>>
+    UnorderedMap(InputIt first, InputIt last, size_t bucket_count = 0, const Hash &hash = Hash(),
+                 const Equal &equal = Equal(), const Alloc &alloc = Alloc());
+
+    // first slot of the home group of hash
+    size_t bucket_of(size_t hash) const;
+
+private:
+    // meta holds one control byte per slot
+    using Table::meta;
+    using Table::slots;
+    using Table::capacity;
+    using Table::growth_left;
+    using Table::equality;
+    UNORDERED_MAP_COUNT(using Table::counters;)
+
+    static int8_t h2_of(size_t hash);
+    size_t group_mask() const;
+
+    template <typename U>
+    size_t find_slot(const U &key, size_t hash) const;
+    size_t find_free_slot(size_t hash) const;
+    void set_ctrl(size_t ind, int8_t value);
+
+    size_t place_slot(size_t hash);
+    size_t insert_slot(size_t hash);
+    void abandon_slot(size_t ind);
+    void fill_slot(size_t ind, size_t hash);
+    void clear_slot(size_t ind);
+    size_t probe_distance(size_t ind) const;
+};
+
+// constructors
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template <typename InputIt, typename>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::UnorderedMap(InputIt first, InputIt last, size_t bucket_count, const Hash &hash,
+                                                                        const Equal &equal, const Alloc &alloc)
+    : Table(bucket_count, hash, equal, alloc)
+{
+    this->insert_range(first, last);
+}
+
+// hashing helpers
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+int8_t UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::h2_of(size_t hash)
+{
+    return static_cast<int8_t>(hash & 0x7F);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::group_mask() const
+{
+    return capacity / FlatGroup::width - 1;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::bucket_of(size_t hash) const
+{
+    return ((hash >> 7) & group_mask()) * FlatGroup::width;
+}
+
+// probing
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template <typename U>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::find_slot(const U &key, size_t hash) const
+{
+    if (capacity == 0)
+    {
+        UNORDERED_MAP_COUNT(counters.record_lookup(0);)
+        return capacity;
+    }
+
+    size_t group_ind = (hash >> 7) & group_mask();
+    int8_t h2 = h2_of(hash);
+
+    for (size_t step = 1;; ++step)
+    {
+        size_t group_start = group_ind * FlatGroup::width;
+        FlatGroup group(meta + group_start);
+
+        for (uint32_t mask = group.match(h2); mask != 0; mask &= mask - 1)
+        {
+            size_t ind = group_start + FlatGroup::lowest(mask);
+            if (equality()(slots[ind].first, key))
+            {
+                UNORDERED_MAP_COUNT(counters.record_lookup(step);)
+                return ind;
+            }
+        }
+
+        if (group.match_empty() != 0)
+        {
+            UNORDERED_MAP_COUNT(counters.record_lookup(step);)
+            return capacity;
+        }
+
+        group_ind = (group_ind + step) & group_mask();
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::find_free_slot(size_t hash) const
+{
+    size_t group_ind = (hash >> 7) & group_mask();
+
+    for (size_t step = 1;; ++step)
+    {
+        size_t group_start = group_ind * FlatGroup::width;
+        uint32_t mask = FlatGroup(meta + group_start).match_empty_or_deleted();
+
+        if (mask != 0)
+        {
+            return group_start + FlatGroup::lowest(mask);
+        }
+
+        group_ind = (group_ind + step) & group_mask();
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::set_ctrl(size_t ind, int8_t value)
+{
+    meta[ind] = value;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::place_slot(size_t hash)
+{
+    // a rehashed table has no tombstones and always room, the element can be marked right away
+    size_t ind = find_free_slot(hash);
+    set_ctrl(ind, h2_of(hash));
+    return ind;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::insert_slot(size_t hash)
+{
+    return find_free_slot(hash);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::abandon_slot(size_t)
+{
+    // the control byte is written only by fill_slot, so nothing has to be undone
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::fill_slot(size_t ind, size_t hash)
+{
+    UNORDERED_MAP_COUNT(counters.record_insert(ind / FlatGroup::width != ((hash >> 7) & group_mask()));)
+
+    // reusing a tombstone does not use up an empty slot
+    if (meta[ind] == flat_empty)
+    {
+        --growth_left;
+    }
+    set_ctrl(ind, h2_of(hash));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::clear_slot(size_t ind)
+{
+    // a group that already has an empty slot never let a probe pass through it,
+    // otherwise the slot has to stay a tombstone
+    size_t group_start = ind - ind % FlatGroup::width;
+    if (FlatGroup(meta + group_start).match_empty() != 0)
+    {
+        set_ctrl(ind, flat_empty);
+        ++growth_left;
+    }
+    else
+    {
+        set_ctrl(ind, flat_deleted);
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatStorage>::probe_distance(size_t ind) const
+{
+    // replay the probe sequence from the home group up to the group holding the element
+    size_t group_ind = (this->get_hash(slots[ind].first) >> 7) & group_mask();
+    size_t distance = 0;
+    while (group_ind != ind / FlatGroup::width)
+    {
+        ++distance;
+        group_ind = (group_ind + distance) & group_mask();
+    }
+    return distance;
+}
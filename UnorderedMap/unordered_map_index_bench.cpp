@@ -0,0 +1,81 @@
+
+#include "unordered_map.cpp"
+
+#include <chrono>
+#include <random>
+#include <string>
+
+// compares the bucket index policies of the chained engine on the same key sets
+// usage: UnorderedMapIndexBench [max_elements]
+
+template <typename Policy>
+using PolicyMap = UnorderedMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                               std::allocator<std::pair<const uint64_t, uint64_t>>, ChainedStorage<true, false, Policy>>;
+
+template <typename Func>
+double measure_ns(size_t ops, Func &&func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count() / static_cast<double>(ops);
+}
+
+template <typename Policy>
+void run_policy(const char *name, const std::vector<uint64_t> &keys, const std::vector<uint64_t> &misses)
+{
+    PolicyMap<Policy> bench_map;
+    uint64_t sink = 0;
+
+    double insert_ns = measure_ns(keys.size(), [&]()
+    {
+        for (uint64_t key : keys)
+        {
+            bench_map.insert({key, key});
+        }
+    });
+
+    double hit_ns = measure_ns(keys.size(), [&]()
+    {
+        for (uint64_t key : keys)
+        {
+            sink += bench_map.find(key)->second;
+        }
+    });
+
+    double miss_ns = measure_ns(misses.size(), [&]()
+    {
+        for (uint64_t key : misses)
+        {
+            sink += (bench_map.find(key) == bench_map.end());
+        }
+    });
+
+    std::cout << name << "\t" << keys.size() << "\t" << insert_ns << "\t" << hit_ns << "\t" << miss_ns
+              << "\t" << bench_map.load_factor() << "\t(" << sink % 10 << ")\n";
+}
+
+int main(int argc, char **argv)
+{
+
+    size_t max_elements = (argc > 1 ? std::stoull(argv[1]) : 1000000);
+
+    std::cout << "policy\tsize\tinsert ns\thit ns\tmiss ns\tload\n";
+
+    std::mt19937_64 rng(42);
+    for (size_t elements = 1000; elements <= max_elements; elements *= 10)
+    {
+        // sequential keys hit the identity std::hash, random keys are the friendly case
+        std::vector<uint64_t> keys(elements), misses(elements);
+        for (size_t i = 0; i < elements; i++)
+        {
+            keys[i] = (i % 2 == 0 ? i : rng());
+            misses[i] = rng() | 1ull << 63;
+        }
+
+        run_policy<ModuloIndex>("modulo", keys, misses);
+        run_policy<MaskIndex>("mask", keys, misses);
+        run_policy<FastRangeIndex>("fastrange", keys, misses);
+        run_policy<PrimeIndex>("prime", keys, misses);
+    }
+}
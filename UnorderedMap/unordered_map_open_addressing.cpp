@@ -0,0 +1,898 @@
+// Common part of the open addressing engines of UnorderedMap (included from unordered_map.cpp)
+//
+// Keys and values live in one contiguous array of slots next to an array of per slot metadata
+// (control bytes for FlatStorage, probe distances for RobinHoodStorage) that ends with one sentinel
+// entry, which stops iteration. OpenAddressingTable owns both arrays, the iterators, copying, growth,
+// lookup and erase; the engine only decides where a key lives. Derived supplies
+//     find_slot(key, hash)  slot holding key, capacity on a miss
+//     place_slot(hash)      free slot for an element moved by a rehash, with its metadata already set,
+//                           capacity if the table has to grow first
+//     insert_slot(hash)     free slot for a new element, called once the table has room
+//     abandon_slot(ind)     undoes insert_slot when the constructor of the element throws
+//     fill_slot(ind, hash)  marks the constructed element in ind as present
+//     clear_slot(ind)       marks the destroyed element in ind as gone
+//     probe_distance(ind)   number of probe steps the element in ind is away from the start of its probe
+//     bucket_of(hash)       first slot of the probe of hash
+// Meta describes the metadata entries: their type, the empty and sentinel values and is_free.
+
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+class OpenAddressingTable
+    : private EboHolder<Hash, 0>, private EboHolder<Equal, 1>,
+      private EboHolder<typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<Key, Value>>, 2>,
+      public MapFrontEnd<Derived, Key, Value, IsTransparent<Hash>::value && IsTransparent<Equal>::value>
+{
+    using HashHolder = EboHolder<Hash, 0>;
+    using EqualHolder = EboHolder<Equal, 1>;
+    using AllocHolder = EboHolder<typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<Key, Value>>, 2>;
+    using Front = MapFrontEnd<Derived, Key, Value, IsTransparent<Hash>::value && IsTransparent<Equal>::value>;
+
+public:
+    // keys hashed and prefetched ahead of the probes in find_batch/insert_batch
+    static constexpr size_t batch_window = 16;
+
+    using NodeType = std::pair<Key, Value>;
+
+    template <bool IsConst>
+    class common_iterator;
+
+    using Iterator = common_iterator<false>;
+    using ConstIterator = common_iterator<true>;
+
+    static constexpr bool transparent = IsTransparent<Hash>::value && IsTransparent<Equal>::value;
+
+protected:
+    using MetaType = typename Meta::type;
+    using SlotAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<NodeType>;
+    using SlotTraits = std::allocator_traits<SlotAlloc>;
+    using MetaAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<MetaType>;
+    using MetaTraits = std::allocator_traits<MetaAlloc>;
+
+    // capacity metadata entries followed by one sentinel that stops iteration
+    MetaType *meta = nullptr;
+    NodeType *slots = nullptr;
+
+    // growth_left counts the inserts left before the table has to be rebuilt
+    size_t capacity = 0, curr_size = 0, growth_left = 0;
+    double max_lf;
+
+    UNORDERED_MAP_COUNT(mutable MapCounters counters;)
+
+    Derived &self();
+    const Derived &self() const;
+
+    const Hash &hasher() const;
+    const Equal &equality() const;
+    SlotAlloc &slot_alloc();
+    const SlotAlloc &slot_alloc() const;
+
+    static size_t mix_hash(size_t hash);
+    size_t max_fill(size_t cap) const;
+
+    void allocate_table(size_t new_cap);
+    void deallocate_table();
+    void resize(size_t new_cap);
+    void prepare_insert();
+    void erase_slot(size_t ind);
+
+    void prefetch_bucket(size_t hash) const;
+
+public:
+    Iterator begin();
+    ConstIterator begin() const;
+
+    Iterator end();
+    ConstIterator end() const;
+
+    ConstIterator cbegin() const;
+    ConstIterator cend() const;
+
+    template <typename U>
+    size_t get_hash(U &&key) const;
+    template <typename U>
+    size_t hash_of(const U &key) const;
+
+    OpenAddressingTable();
+    explicit OpenAddressingTable(size_t bucket_count, const Hash &hash = Hash(), const Equal &equal = Equal(),
+                                 const Alloc &alloc = Alloc());
+    explicit OpenAddressingTable(const Alloc &alloc);
+
+    OpenAddressingTable(const OpenAddressingTable &other);
+    OpenAddressingTable(OpenAddressingTable &&other);
+
+    ~OpenAddressingTable();
+
+    Hash hash_function() const;
+    Equal key_eq() const;
+    Alloc get_allocator() const;
+
+    size_t size() const;
+
+    double &max_load_factor();
+
+    void max_load_factor(double new_load_factor);
+
+    double load_factor() const;
+
+    void reserve(size_t needed_cap);
+
+    size_t max_size() const;
+
+    // probe distances of every element, walks the whole table, so it costs O(bucket_count)
+    UnorderedMapStats stats() const;
+
+    using Front::erase;
+    void erase(ConstIterator to_erase);
+    void erase(ConstIterator first, ConstIterator second);
+
+    void rehash();
+
+    OpenAddressingTable &operator=(const OpenAddressingTable &other);
+    OpenAddressingTable &operator=(OpenAddressingTable &&other);
+
+    void swap(OpenAddressingTable &other);
+
+    template <typename U>
+    Iterator find(U &&key);
+
+    template <typename U>
+    ConstIterator find(U &&key) const;
+
+    // keys come from a forward range, one iterator per key is written to out, end() for misses
+    template <typename KeyIt, typename OutIt>
+    OutIt find_batch(KeyIt first, KeyIt last, OutIt out);
+    template <typename KeyIt, typename OutIt>
+    OutIt find_batch(KeyIt first, KeyIt last, OutIt out) const;
+
+    // pairs come from a forward range, returns the number of inserted keys
+    template <typename InputIt>
+    size_t insert_batch(InputIt first, InputIt last);
+
+    // probes for key and builds the pair from node_args only on a miss
+    template <typename K, typename... Args>
+    std::pair<Iterator, bool> emplace_hashed(const K &key, size_t hash, Args &&...node_args);
+};
+
+// iterator
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+template <bool IsConst>
+class OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::common_iterator
+{
+    friend class OpenAddressingTable;
+    friend class common_iterator<!IsConst>;
+
+    const MetaType *meta;
+    std::conditional_t<IsConst, const NodeType *, NodeType *> slot;
+
+    void skip_free()
+    {
+        while (Meta::is_free(*meta))
+        {
+            ++meta;
+            ++slot;
+        }
+    }
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = NodeType;
+    using pointer = std::conditional_t<IsConst, const NodeType *, NodeType *>;
+    using reference = std::conditional_t<IsConst, const NodeType &, NodeType &>;
+    using difference_type = std::ptrdiff_t;
+
+    common_iterator(const MetaType *meta_pos = nullptr, pointer slot_pos = nullptr) : meta(meta_pos), slot(slot_pos)
+    {
+    }
+
+    common_iterator(const common_iterator<false> &other) : meta(other.meta), slot(other.slot)
+    {
+    }
+
+    common_iterator &operator=(const common_iterator &other) = default;
+
+    reference operator*() const
+    {
+        return *slot;
+    }
+
+    pointer operator->() const
+    {
+        return slot;
+    }
+
+    common_iterator &operator++()
+    {
+        ++meta;
+        ++slot;
+        skip_free();
+        return *this;
+    }
+
+    common_iterator operator++(int)
+    {
+        auto copy = *this;
+        ++(*this);
+        return copy;
+    }
+
+    bool operator==(const common_iterator &other) const
+    {
+        return meta == other.meta;
+    }
+
+    bool operator!=(const common_iterator &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// stored functors
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+Derived &OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::self()
+{
+    return static_cast<Derived &>(*this);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+const Derived &OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::self() const
+{
+    return static_cast<const Derived &>(*this);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+const Hash &OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::hasher() const
+{
+    return HashHolder::get();
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+const Equal &OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::equality() const
+{
+    return EqualHolder::get();
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::SlotAlloc &OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::slot_alloc()
+{
+    return AllocHolder::get();
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+const typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::SlotAlloc &OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::slot_alloc() const
+{
+    return AllocHolder::get();
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+Hash OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::hash_function() const
+{
+    return hasher();
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+Equal OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::key_eq() const
+{
+    return equality();
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+Alloc OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::get_allocator() const
+{
+    return Alloc(AllocHolder::get());
+}
+
+// hashing helpers
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+size_t OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::mix_hash(size_t hash)
+{
+    // std::hash is the identity for integers, spread the bits before the engine splits them up
+    uint64_t mixed = static_cast<uint64_t>(hash);
+    mixed ^= mixed >> 32;
+    mixed *= 0x9E3779B97F4A7C15ull;
+    mixed ^= mixed >> 29;
+    return static_cast<size_t>(mixed);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+template <typename U>
+size_t OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::get_hash(U &&key) const
+{
+    return mix_hash(hasher()(std::forward<U>(key)));
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+template <typename U>
+size_t OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::hash_of(const U &key) const
+{
+    return get_hash(key);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+size_t OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::max_fill(size_t cap) const
+{
+    size_t fill = static_cast<size_t>(static_cast<double>(cap) * max_lf);
+    if (fill == 0)
+    {
+        return 1;
+    }
+    // at least one free slot keeps every probe sequence finite
+    return (fill < cap ? fill : cap - 1);
+}
+
+// memory allocation
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::allocate_table(size_t new_cap)
+{
+    MetaAlloc meta_alloc(slot_alloc());
+
+    meta = MetaTraits::allocate(meta_alloc, new_cap + 1);
+    try
+    {
+        slots = SlotTraits::allocate(slot_alloc(), new_cap);
+    }
+    catch (...)
+    {
+        MetaTraits::deallocate(meta_alloc, meta, new_cap + 1);
+        meta = nullptr;
+        throw;
+    }
+
+    std::fill(meta, meta + new_cap, Meta::empty);
+    meta[new_cap] = Meta::sentinel;
+
+    capacity = new_cap;
+    growth_left = max_fill(new_cap);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::deallocate_table()
+{
+    if (capacity == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < capacity; i++)
+    {
+        if (!Meta::is_free(meta[i]))
+        {
+            SlotTraits::destroy(slot_alloc(), slots + i);
+        }
+    }
+
+    MetaAlloc meta_alloc(slot_alloc());
+    MetaTraits::deallocate(meta_alloc, meta, capacity + 1);
+    SlotTraits::deallocate(slot_alloc(), slots, capacity);
+
+    meta = nullptr;
+    slots = nullptr;
+    capacity = 0;
+    curr_size = 0;
+    growth_left = 0;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::resize(size_t new_cap)
+{
+    MetaType *old_meta = meta;
+    NodeType *old_slots = slots;
+    size_t old_cap = capacity;
+    size_t old_size = curr_size;
+    UNORDERED_MAP_COUNT(auto rehash_started = MapCounters::Clock::now();)
+
+    allocate_table(new_cap);
+
+    for (size_t i = 0; i < old_cap; i++)
+    {
+        if (Meta::is_free(old_meta[i]))
+        {
+            continue;
+        }
+
+        size_t hash = get_hash(old_slots[i].first);
+        size_t ind = self().place_slot(hash);
+        while (ind == capacity)
+        {
+            // the new table is valid on its own, so an engine that runs out of room just grows it once more
+            resize(capacity << 1);
+            ind = self().place_slot(hash);
+        }
+
+        SlotTraits::construct(slot_alloc(), slots + ind, std::move(old_slots[i]));
+        SlotTraits::destroy(slot_alloc(), old_slots + i);
+    }
+
+    curr_size = old_size;
+    growth_left = max_fill(capacity) - old_size;
+
+    if (old_cap != 0)
+    {
+        MetaAlloc meta_alloc(slot_alloc());
+        MetaTraits::deallocate(meta_alloc, old_meta, old_cap + 1);
+        SlotTraits::deallocate(slot_alloc(), old_slots, old_cap);
+    }
+
+    UNORDERED_MAP_COUNT(counters.record_rehash(rehash_started);)
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::prepare_insert()
+{
+    if (growth_left != 0)
+    {
+        return;
+    }
+
+    size_t new_cap = (capacity == 0 ? Derived::init_cap : capacity);
+
+    // a table whose room went to tombstones only needs cleaning, otherwise it grows
+    if (curr_size * 2 > max_fill(new_cap))
+    {
+        while (max_fill(new_cap) <= curr_size)
+        {
+            new_cap <<= 1;
+        }
+    }
+
+    resize(new_cap);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::rehash()
+{
+    resize(capacity == 0 ? Derived::init_cap : capacity << 1);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::reserve(size_t needed_cap)
+{
+    size_t new_cap = (capacity == 0 ? Derived::init_cap : capacity);
+    while (max_fill(new_cap) < needed_cap)
+    {
+        new_cap <<= 1;
+    }
+
+    if (new_cap != capacity)
+    {
+        resize(new_cap);
+    }
+}
+
+// constructors
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::OpenAddressingTable() : max_lf(Derived::init_load_factor)
+{
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::OpenAddressingTable(size_t bucket_count, const Hash &hash, const Equal &equal,
+                                                                                        const Alloc &alloc)
+    : HashHolder(hash), EqualHolder(equal), AllocHolder(SlotAlloc(alloc)), max_lf(Derived::init_load_factor)
+{
+    if (bucket_count == 0)
+    {
+        return;
+    }
+
+    size_t new_cap = Derived::init_cap;
+    while (new_cap < bucket_count)
+    {
+        new_cap <<= 1;
+    }
+    allocate_table(new_cap);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::OpenAddressingTable(const Alloc &alloc)
+    : AllocHolder(SlotAlloc(alloc)), max_lf(Derived::init_load_factor)
+{
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::OpenAddressingTable(const OpenAddressingTable &other)
+    : HashHolder(other.hasher()), EqualHolder(other.equality()),
+      AllocHolder(SlotTraits::select_on_container_copy_construction(other.slot_alloc())), Front(), max_lf(other.max_lf)
+{
+    if (other.capacity == 0)
+    {
+        return;
+    }
+
+    allocate_table(other.capacity);
+
+    // same capacity and hash, so the layout can be copied slot by slot
+    size_t i = 0;
+    try
+    {
+        for (; i < capacity; i++)
+        {
+            if (!Meta::is_free(other.meta[i]))
+            {
+                SlotTraits::construct(slot_alloc(), slots + i, other.slots[i]);
+            }
+            meta[i] = other.meta[i];
+        }
+    }
+    catch (...)
+    {
+        deallocate_table();
+        throw;
+    }
+
+    curr_size = other.curr_size;
+    growth_left = other.growth_left;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::OpenAddressingTable(OpenAddressingTable &&other)
+    : HashHolder(other.hasher()), EqualHolder(other.equality()), AllocHolder(other.slot_alloc()), Front(),
+      meta(other.meta), slots(other.slots), capacity(other.capacity), curr_size(other.curr_size),
+      growth_left(other.growth_left), max_lf(other.max_lf)
+{
+    other.meta = nullptr;
+    other.slots = nullptr;
+    other.capacity = 0;
+    other.curr_size = 0;
+    other.growth_left = 0;
+    other.max_lf = Derived::init_load_factor;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::~OpenAddressingTable()
+{
+    deallocate_table();
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta> &OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::operator=(const OpenAddressingTable &other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    OpenAddressingTable copy(other);
+
+    swap(copy);
+
+    return *this;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta> &OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::operator=(OpenAddressingTable &&other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    OpenAddressingTable copy(std::move(other));
+
+    swap(copy);
+
+    return *this;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::swap(OpenAddressingTable &other)
+{
+    std::swap(meta, other.meta);
+    std::swap(slots, other.slots);
+    std::swap(capacity, other.capacity);
+    std::swap(curr_size, other.curr_size);
+    std::swap(growth_left, other.growth_left);
+    std::swap(max_lf, other.max_lf);
+    std::swap(static_cast<HashHolder &>(*this), static_cast<HashHolder &>(other));
+    std::swap(static_cast<EqualHolder &>(*this), static_cast<EqualHolder &>(other));
+    std::swap(static_cast<AllocHolder &>(*this), static_cast<AllocHolder &>(other));
+}
+
+// self-info
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+size_t OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::size() const
+{
+    return curr_size;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+size_t OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::max_size() const
+{
+    return SlotTraits::max_size(slot_alloc());
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+double &OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::max_load_factor()
+{
+    return max_lf;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::max_load_factor(double new_load_factor)
+{
+    max_lf = new_load_factor;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+double OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::load_factor() const
+{
+    if (capacity == 0)
+    {
+        return 0;
+    }
+    return (static_cast<double>(curr_size) / static_cast<double>(capacity));
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+UnorderedMapStats OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::stats() const
+{
+    UnorderedMapStats result;
+    result.size = curr_size;
+    result.bucket_count = capacity;
+    result.load_factor = load_factor();
+    result.chain_lengths.assign(1, 0);
+
+    for (size_t i = 0; i < capacity; i++)
+    {
+        if (Meta::is_free(meta[i]))
+        {
+            continue;
+        }
+
+        size_t distance = self().probe_distance(i);
+        if (result.chain_lengths.size() <= distance)
+        {
+            result.chain_lengths.resize(distance + 1, 0);
+        }
+        ++result.chain_lengths[distance];
+        result.max_probe_length = std::max(result.max_probe_length, distance + 1);
+        result.collisions += (distance != 0);
+    }
+
+    result.bucket_bytes = (capacity == 0 ? 0 : (capacity + 1) * sizeof(MetaType));
+    result.node_bytes = curr_size * sizeof(NodeType);
+    // unused slots and the map object itself
+    result.overhead_bytes = (capacity - curr_size) * sizeof(NodeType) + sizeof(Derived);
+
+    UNORDERED_MAP_COUNT(counters.fill(result);)
+    return result;
+}
+
+// iterator initialization
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::Iterator OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::begin()
+{
+    if (capacity == 0)
+    {
+        return end();
+    }
+
+    Iterator iter(meta, slots);
+    iter.skip_free();
+    return iter;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::ConstIterator OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::begin() const
+{
+    return cbegin();
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::Iterator OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::end()
+{
+    return Iterator(meta + capacity, slots + capacity);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::ConstIterator OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::end() const
+{
+    return cend();
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::ConstIterator OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::cbegin() const
+{
+    if (capacity == 0)
+    {
+        return cend();
+    }
+
+    ConstIterator iter(meta, slots);
+    iter.skip_free();
+    return iter;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::ConstIterator OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::cend() const
+{
+    return ConstIterator(meta + capacity, slots + capacity);
+}
+
+// lookup
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+template <typename U>
+typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::Iterator OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::find(U &&key)
+{
+    const auto &lookup = lookup_key<Key, transparent>(key);
+    size_t ind = self().find_slot(lookup, get_hash(lookup));
+    return Iterator(meta + ind, slots + ind);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+template <typename U>
+typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::ConstIterator OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::find(U &&key) const
+{
+    const auto &lookup = lookup_key<Key, transparent>(key);
+    size_t ind = self().find_slot(lookup, get_hash(lookup));
+    return ConstIterator(meta + ind, slots + ind);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::prefetch_bucket(size_t hash) const
+{
+    // first slot of the probe, both its metadata and the slot itself
+    if (capacity != 0)
+    {
+        size_t start = self().bucket_of(hash);
+        prefetch_read(meta + start);
+        prefetch_read(slots + start);
+    }
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+template <typename KeyIt, typename OutIt>
+OutIt OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::find_batch(KeyIt first, KeyIt last, OutIt out)
+{
+    size_t hashes[batch_window];
+    WindowKeys<Key, transparent, KeyIt, batch_window> keys;
+
+    while (first != last)
+    {
+        // hash the whole window first, so the metadata and slot misses overlap
+        size_t count = 0;
+        for (KeyIt iter = first; iter != last && count < batch_window; ++iter, ++count)
+        {
+            hashes[count] = get_hash(keys.load(count, iter));
+            prefetch_bucket(hashes[count]);
+        }
+
+        for (size_t i = 0; i < count; ++i, ++first)
+        {
+            size_t ind = self().find_slot(keys.get(i, first), hashes[i]);
+            *out = Iterator(meta + ind, slots + ind);
+            ++out;
+        }
+    }
+    return out;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+template <typename KeyIt, typename OutIt>
+OutIt OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::find_batch(KeyIt first, KeyIt last, OutIt out) const
+{
+    size_t hashes[batch_window];
+    WindowKeys<Key, transparent, KeyIt, batch_window> keys;
+
+    while (first != last)
+    {
+        size_t count = 0;
+        for (KeyIt iter = first; iter != last && count < batch_window; ++iter, ++count)
+        {
+            hashes[count] = get_hash(keys.load(count, iter));
+            prefetch_bucket(hashes[count]);
+        }
+
+        for (size_t i = 0; i < count; ++i, ++first)
+        {
+            size_t ind = self().find_slot(keys.get(i, first), hashes[i]);
+            *out = ConstIterator(meta + ind, slots + ind);
+            ++out;
+        }
+    }
+    return out;
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+template <typename InputIt>
+size_t OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::insert_batch(InputIt first, InputIt last)
+{
+    size_t hashes[batch_window], inserted = 0;
+
+    while (first != last)
+    {
+        size_t count = 0;
+        for (InputIt iter = first; iter != last && count < batch_window; ++iter, ++count)
+        {
+            hashes[count] = get_hash((*iter).first);
+        }
+
+        // grow once for the whole window, a resize in the middle would waste the prefetches
+        if (growth_left < count)
+        {
+            reserve(curr_size + count);
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            prefetch_bucket(hashes[i]);
+        }
+
+        for (size_t i = 0; i < count; ++i, ++first)
+        {
+            inserted += emplace_hashed((*first).first, hashes[i], *first).second;
+        }
+    }
+    return inserted;
+}
+
+// element insertion/deletion
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+template <typename K, typename... Args>
+std::pair<typename OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::Iterator, bool> OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::emplace_hashed(const K &key, size_t hash, Args &&...node_args)
+{
+    size_t ind = self().find_slot(key, hash);
+
+    if (ind != capacity)
+    {
+        return std::make_pair(Iterator(meta + ind, slots + ind), false);
+    }
+
+    prepare_insert();
+    ind = self().insert_slot(hash);
+
+    // the pair is built only on a miss and after the probe, so node_args may still refer to key;
+    // a throwing constructor gives the slot back, so the table is left as it was
+    try
+    {
+        SlotTraits::construct(slot_alloc(), slots + ind, std::forward<Args>(node_args)...);
+    }
+    catch (...)
+    {
+        self().abandon_slot(ind);
+        throw;
+    }
+    self().fill_slot(ind, hash);
+    ++curr_size;
+
+    return std::make_pair(Iterator(meta + ind, slots + ind), true);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::erase_slot(size_t ind)
+{
+    SlotTraits::destroy(slot_alloc(), slots + ind);
+    --curr_size;
+
+    self().clear_slot(ind);
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::erase(ConstIterator to_erase)
+{
+    erase_slot(static_cast<size_t>(to_erase.meta - meta));
+}
+
+template <typename Derived, typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Meta>
+void OpenAddressingTable<Derived, Key, Value, Hash, Equal, Alloc, Meta>::erase(ConstIterator first, ConstIterator second)
+{
+    size_t left = 0;
+    for (ConstIterator iter = first; iter != second; ++iter)
+    {
+        ++left;
+    }
+
+    // an engine may pull later elements back onto an erased slot, but never reorders them,
+    // so the next element of the range is always the first one at or after ind
+    size_t ind = static_cast<size_t>(first.meta - meta);
+    for (; left > 0; --left)
+    {
+        while (Meta::is_free(meta[ind]))
+        {
+            ++ind;
+        }
+        erase_slot(ind);
+    }
+}
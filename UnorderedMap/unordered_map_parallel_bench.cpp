@@ -0,0 +1,58 @@
+
+#include "unordered_map.cpp"
+
+#include <chrono>
+#include <random>
+#include <string>
+
+// bulk load of a vector of pairs: presized insert_range against insert_parallel,
+// and a parallel rehash to four times the bucket count, for doubling thread counts
+// usage: UnorderedMapParallelBench [elements] [max_threads]
+
+template <typename Func>
+double measure_ms(Func &&func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(finish - start).count();
+}
+
+int main(int argc, char **argv)
+{
+
+    size_t elements = (argc > 1 ? std::stoull(argv[1]) : 10000000);
+    size_t max_threads = (argc > 2 ? std::stoull(argv[2]) : std::max<size_t>(1, std::thread::hardware_concurrency()));
+
+    using BenchMap = UnorderedMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                                  std::allocator<std::pair<const uint64_t, uint64_t>>, ChainedStorage<true>>;
+
+    std::mt19937_64 rng(11);
+    std::vector<std::pair<uint64_t, uint64_t>> pairs(elements);
+    for (size_t i = 0; i < elements; i++)
+    {
+        pairs[i] = {rng(), i};
+    }
+
+    double serial_ms = measure_ms([&]()
+    {
+        BenchMap bench_map;
+        bench_map.insert_range(pairs.begin(), pairs.end());
+    });
+    std::cout << "insert_range\t" << serial_ms << " ms\n";
+
+    std::cout << "threads\tinsert_parallel ms\trehash ms\n";
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        BenchMap bench_map;
+        double build_ms = measure_ms([&]()
+        {
+            bench_map.insert_parallel(pairs.begin(), pairs.end(), ThreadExecutor(threads));
+        });
+        double rehash_ms = measure_ms([&]()
+        {
+            bench_map.rehash(bench_map.capacity * 4, ThreadExecutor(threads));
+        });
+        std::cout << threads << "\t" << build_ms << "\t" << rehash_ms << "\n";
+    }
+}
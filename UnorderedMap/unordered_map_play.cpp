@@ -1,4 +1,9 @@
+
 #include "unordered_map.cpp"
+#include "unordered_map_snapshot.cpp"
+#include "unordered_map_stream.cpp"
+
+#include <sstream>
 
 int main() {
 
@@ -10,4 +15,30 @@ int main() {
 
     std::cout << test_map[1] << test_map[4];
 
-}
\ No newline at end of file
+    UnorderedMap<int, int, std::hash<int>, std::equal_to<int>, std::allocator<std::pair<const int, int>>, FlatStorage> flat_map;
+
+    flat_map.insert({1, 2});
+    flat_map.insert({4, 5});
+
+    std::cout << flat_map[1] << flat_map[4];
+
+    std::string image = build_snapshot(test_map);
+    MappedUnorderedMap<int, int> mapped_map(image.data(), image.size());
+
+    std::cout << mapped_map.at(1) << mapped_map.at(4);
+
+    std::stringstream checkpoint;
+    write_stream(flat_map, checkpoint);
+    UnorderedMap<int, int> loaded_map;
+    read_stream(checkpoint, loaded_map);
+
+    std::cout << loaded_map.at(1) << loaded_map.at(4);
+
+    auto node = loaded_map.extract(4);
+    node.key() = 7;
+    test_map.insert(std::move(node));
+    test_map.merge(loaded_map);
+
+    std::cout << test_map.at(7) << test_map.size() << loaded_map.size();
+
+}
@@ -0,0 +1,236 @@
+// Robin Hood storage engine for UnorderedMap (included from unordered_map.cpp)
+//
+// Keys and values live in one contiguous array of slots probed linearly from the home slot of
+// their hash. Every slot keeps its probe distance + 1 (0 marks a free slot), an insert takes the
+// slot of the first element that sits closer to its own home and pushes the rest of the run one
+// slot further. Runs stay sorted by home slot, so a lookup stops as soon as it meets an element
+// closer to home than itself, which keeps probes short up to a load factor of 0.9.
+// Erase shifts the rest of the run one slot back (backward-shift deletion): there are no
+// tombstones, so heavy insert/erase churn never slows lookups down or forces a rebuild.
+// Both insert and erase move other elements, so they invalidate iterators and references.
+// The slot arrays, iterators and growth are shared with flat (unordered_map_open_addressing.cpp).
+
+#include <cstdint>
+#include <stdexcept>
+
+// probe distances as seen by OpenAddressingTable, kept as distance + 1 so 0 marks a free slot
+struct RobinHoodMeta
+{
+    using type = uint16_t;
+
+    static constexpr uint16_t empty = 0;
+    static constexpr uint16_t sentinel = 0xFFFF;
+
+    static bool is_free(uint16_t dist)
+    {
+        return dist == empty;
+    }
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+class UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>
+    : public OpenAddressingTable<UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>, Key, Value, Hash, Equal, Alloc, RobinHoodMeta>
+{
+    using Table = OpenAddressingTable<UnorderedMap, Key, Value, Hash, Equal, Alloc, RobinHoodMeta>;
+    friend Table;
+
+public:
+    static constexpr size_t init_cap = 16;
+    static constexpr double init_load_factor = 0.9d;
+
+    // the slot past the last one holds dist_sentinel
+    static constexpr uint16_t dist_free = RobinHoodMeta::empty;
+    static constexpr uint16_t dist_sentinel = RobinHoodMeta::sentinel;
+    static constexpr uint16_t max_dist = 0xFFFE;
+
+    using Table::Table;
+
+    template <typename InputIt, typename = RequireInputIter<InputIt>>
+    UnorderedMap(InputIt first, InputIt last, size_t bucket_count = 0, const Hash &hash = Hash(),
+                 const Equal &equal = Equal(), const Alloc &alloc = Alloc());
+
+    // home slot of hash
+    size_t bucket_of(size_t hash) const;
+
+private:
+    // meta holds the probe distance + 1 of every slot
+    using Table::meta;
+    using Table::slots;
+    using Table::capacity;
+    using Table::growth_left;
+    using Table::max_lf;
+    using Table::equality;
+    using Table::slot_alloc;
+    using Table::resize;
+    using typename Table::SlotTraits;
+    UNORDERED_MAP_COUNT(using Table::counters;)
+
+    template <typename U>
+    size_t find_slot(const U &key, size_t hash) const;
+    void shift_back(size_t ind);
+
+    size_t place_slot(size_t hash);
+    size_t insert_slot(size_t hash);
+    void abandon_slot(size_t ind);
+    void fill_slot(size_t ind, size_t hash);
+    void clear_slot(size_t ind);
+    size_t probe_distance(size_t ind) const;
+};
+
+// constructors
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template <typename InputIt, typename>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::UnorderedMap(InputIt first, InputIt last, size_t bucket_count, const Hash &hash,
+                                                                             const Equal &equal, const Alloc &alloc)
+    : Table(bucket_count, hash, equal, alloc)
+{
+    this->insert_range(first, last);
+}
+
+// hashing helpers
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::bucket_of(size_t hash) const
+{
+    return hash & (capacity - 1);
+}
+
+// probing
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+template <typename U>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::find_slot(const U &key, size_t hash) const
+{
+    if (capacity == 0)
+    {
+        UNORDERED_MAP_COUNT(counters.record_lookup(0);)
+        return capacity;
+    }
+
+    size_t mask = capacity - 1;
+    size_t ind = bucket_of(hash);
+
+    // an element closer to its home than the probe means the key would have taken its slot
+    uint32_t probe = 1;
+    for (; meta[ind] >= probe; ++probe)
+    {
+        if (meta[ind] == probe && equality()(slots[ind].first, key))
+        {
+            UNORDERED_MAP_COUNT(counters.record_lookup(probe);)
+            return ind;
+        }
+        ind = (ind + 1) & mask;
+    }
+
+    UNORDERED_MAP_COUNT(counters.record_lookup(probe);)
+    return capacity;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::place_slot(size_t hash)
+{
+    size_t mask = capacity - 1;
+    size_t ind = bucket_of(hash);
+
+    uint32_t probe = 1;
+    for (; meta[ind] >= probe; ++probe)
+    {
+        ind = (ind + 1) & mask;
+    }
+    if (probe > max_dist)
+    {
+        return capacity;
+    }
+
+    // the rest of the run moves one slot further, up to the first free slot
+    size_t free_ind = ind;
+    while (meta[free_ind] != dist_free)
+    {
+        if (meta[free_ind] >= max_dist)
+        {
+            return capacity;
+        }
+        free_ind = (free_ind + 1) & mask;
+    }
+
+    while (free_ind != ind)
+    {
+        size_t prev = (free_ind - 1) & mask;
+        SlotTraits::construct(slot_alloc(), slots + free_ind, std::move(slots[prev]));
+        SlotTraits::destroy(slot_alloc(), slots + prev);
+        meta[free_ind] = static_cast<uint16_t>(meta[prev] + 1);
+        free_ind = prev;
+    }
+
+    meta[ind] = static_cast<uint16_t>(probe);
+    return ind;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::shift_back(size_t ind)
+{
+    // slot ind is already destroyed, the elements after it that are away from home move back one slot
+    size_t mask = capacity - 1;
+    size_t next = (ind + 1) & mask;
+
+    while (meta[next] > 1)
+    {
+        SlotTraits::construct(slot_alloc(), slots + ind, std::move(slots[next]));
+        SlotTraits::destroy(slot_alloc(), slots + next);
+        meta[ind] = static_cast<uint16_t>(meta[next] - 1);
+
+        ind = next;
+        next = (next + 1) & mask;
+    }
+
+    meta[ind] = dist_free;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::insert_slot(size_t hash)
+{
+    size_t ind = place_slot(hash);
+    if (ind == capacity)
+    {
+        // a run longer than max_dist only comes from keys with equal hashes, growing cannot split them
+        if (this->load_factor() * 2 < max_lf)
+        {
+            throw std::length_error("Too many keys with the same hash!");
+        }
+        resize(capacity << 1);
+        ind = place_slot(hash);
+        if (ind == capacity)
+        {
+            throw std::length_error("Too many keys with the same hash!");
+        }
+    }
+    return ind;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::abandon_slot(size_t ind)
+{
+    // place_slot already pushed the run forward, pull it back
+    shift_back(ind);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::fill_slot(size_t ind, size_t)
+{
+    (void)ind;
+    UNORDERED_MAP_COUNT(counters.record_insert(meta[ind] != 1);)
+    --growth_left;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::clear_slot(size_t ind)
+{
+    // no tombstones, the slot is free again right away
+    shift_back(ind);
+    ++growth_left;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, RobinHoodStorage>::probe_distance(size_t ind) const
+{
+    // the stored distance is the probe length, nothing has to be replayed
+    return meta[ind] - 1u;
+}
@@ -0,0 +1,897 @@
+// Small storage engine for UnorderedMap (included from unordered_map.cpp)
+//
+// The first InlineCount elements live in slots inside the map object, so a map that stays small
+// never allocates. Every inline slot has a control byte like a flat slot: flat_empty or 7 bits of
+// the hash, and a lookup matches all of them with one FlatGroup compare before comparing keys.
+// The insert that does not fit any more moves the elements into a map of the LargeStorage engine,
+// which serves every later operation.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <utility>
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+class UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>
+    : private EboHolder<Hash, 0>, private EboHolder<Equal, 1>,
+      private EboHolder<typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<Key, Value>>, 2>,
+      public MapFrontEnd<UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>, Key, Value,
+                         IsTransparent<Hash>::value && IsTransparent<Equal>::value>
+{
+    using HashHolder = EboHolder<Hash, 0>;
+    using EqualHolder = EboHolder<Equal, 1>;
+    using AllocHolder = EboHolder<typename std::allocator_traits<Alloc>::template rebind_alloc<std::pair<Key, Value>>, 2>;
+    using Front = MapFrontEnd<UnorderedMap, Key, Value, IsTransparent<Hash>::value && IsTransparent<Equal>::value>;
+
+    // the control bytes past the inline slots stay flat_sentinel, so one group covers them all
+    static_assert(InlineCount > 0 && InlineCount < FlatGroup::width, "inline slots have to fit one control group");
+
+public:
+    static constexpr size_t init_cap = InlineCount;
+    static constexpr double init_load_factor = 0.75d;
+
+    using NodeType = std::pair<Key, Value>;
+    using LargeMap = UnorderedMap<Key, Value, Hash, Equal, Alloc, LargeStorage>;
+
+    template <bool IsConst>
+    class common_iterator;
+
+    using Iterator = common_iterator<false>;
+    using ConstIterator = common_iterator<true>;
+
+    static constexpr bool transparent = IsTransparent<Hash>::value && IsTransparent<Equal>::value;
+
+private:
+    using SlotAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<NodeType>;
+    using SlotTraits = std::allocator_traits<SlotAlloc>;
+
+    int8_t ctrl[FlatGroup::width];
+    alignas(NodeType) unsigned char inline_slots[InlineCount * sizeof(NodeType)];
+    size_t curr_size = 0;
+    double max_lf = init_load_factor;
+
+    // engaged once the map outgrew the inline slots, the inline slots are empty from then on
+    std::optional<LargeMap> large;
+
+    UNORDERED_MAP_COUNT(mutable MapCounters counters;)
+
+    const Hash &hasher() const;
+    const Equal &equality() const;
+    SlotAlloc &slot_alloc();
+    const SlotAlloc &slot_alloc() const;
+
+    NodeType *slots();
+    const NodeType *slots() const;
+
+    static int8_t h2_of(size_t hash);
+
+    template <typename U>
+    size_t find_inline(const U &key, int8_t h2) const;
+
+    void clear_inline();
+    void take_elements(UnorderedMap &other);
+    void spill(size_t needed_cap);
+
+    // turns the iterators written by the large map into iterators of this map
+    template <typename OutIt, typename It>
+    struct WrapOutput
+    {
+        OutIt out;
+
+        WrapOutput &operator*()
+        {
+            return *this;
+        }
+
+        WrapOutput &operator++()
+        {
+            return *this;
+        }
+
+        template <typename LargeIt>
+        WrapOutput &operator=(const LargeIt &iter)
+        {
+            *out = It(iter);
+            ++out;
+            return *this;
+        }
+    };
+
+public:
+    Iterator begin();
+    ConstIterator begin() const;
+
+    Iterator end();
+    ConstIterator end() const;
+
+    ConstIterator cbegin() const;
+    ConstIterator cend() const;
+
+    UnorderedMap();
+    explicit UnorderedMap(size_t bucket_count, const Hash &hash = Hash(), const Equal &equal = Equal(),
+                          const Alloc &alloc = Alloc());
+    explicit UnorderedMap(const Alloc &alloc);
+
+    template <typename InputIt, typename = RequireInputIter<InputIt>>
+    UnorderedMap(InputIt first, InputIt last, size_t bucket_count = 0, const Hash &hash = Hash(),
+                 const Equal &equal = Equal(), const Alloc &alloc = Alloc());
+
+    UnorderedMap(const UnorderedMap &other);
+    UnorderedMap(UnorderedMap &&other);
+
+    ~UnorderedMap();
+
+    Hash hash_function() const;
+    Equal key_eq() const;
+    Alloc get_allocator() const;
+
+    size_t size() const;
+
+    // false while the elements still live in the inline slots
+    bool spilled() const;
+
+    double &max_load_factor();
+
+    void max_load_factor(double new_load_factor);
+
+    double load_factor() const;
+
+    // more than InlineCount elements move the map to the large engine right away
+    void reserve(size_t needed_cap);
+
+    size_t max_size() const;
+
+    // inline slots count as one probe each, after the switch these are the stats of the large map
+    UnorderedMapStats stats() const;
+
+    using Front::erase;
+    void erase(ConstIterator to_erase);
+    void erase(ConstIterator first, ConstIterator second);
+
+    // inline elements are hashed with Hash alone, after the switch this is the hash of the large map
+    template <typename U>
+    size_t hash_of(const U &key) const;
+
+    // probes for key and builds the pair from node_args only on a miss, the insert that finds
+    // the inline slots full moves everything into the large map first
+    template <typename K, typename... Args>
+    std::pair<Iterator, bool> emplace_hashed(const K &key, size_t hash, Args &&...node_args);
+
+    template <typename InputIt>
+    size_t insert_range(InputIt first, InputIt last, bool sort_by_bucket = false);
+
+    void rehash();
+
+    UnorderedMap &operator=(const UnorderedMap &other);
+    UnorderedMap &operator=(UnorderedMap &&other);
+
+    void swap(UnorderedMap &other);
+
+    template <typename U>
+    Iterator find(U &&key);
+
+    template <typename U>
+    ConstIterator find(U &&key) const;
+
+    // keys come from a forward range, one iterator per key is written to out, end() for misses
+    template <typename KeyIt, typename OutIt>
+    OutIt find_batch(KeyIt first, KeyIt last, OutIt out);
+    template <typename KeyIt, typename OutIt>
+    OutIt find_batch(KeyIt first, KeyIt last, OutIt out) const;
+
+    // pairs come from a forward range, returns the number of inserted keys
+    template <typename InputIt>
+    size_t insert_batch(InputIt first, InputIt last);
+};
+
+// iterator
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <bool IsConst>
+class UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::common_iterator
+{
+    friend class UnorderedMap;
+    friend class common_iterator<!IsConst>;
+
+    using LargeIterator = std::conditional_t<IsConst, typename LargeMap::ConstIterator, typename LargeMap::Iterator>;
+
+    // inline slots are walked like flat slots, ctrl stays null for iterators of the large map
+    const int8_t *ctrl;
+    std::conditional_t<IsConst, const NodeType *, NodeType *> slot;
+    LargeIterator large_iter;
+
+    void skip_free()
+    {
+        while (*ctrl < flat_sentinel)
+        {
+            ++ctrl;
+            ++slot;
+        }
+    }
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = NodeType;
+    using pointer = std::conditional_t<IsConst, const NodeType *, NodeType *>;
+    using reference = std::conditional_t<IsConst, const NodeType &, NodeType &>;
+    using difference_type = std::ptrdiff_t;
+
+    common_iterator(const int8_t *ctrl_pos = nullptr, pointer slot_pos = nullptr) : ctrl(ctrl_pos), slot(slot_pos)
+    {
+    }
+
+    explicit common_iterator(LargeIterator iter) : ctrl(nullptr), slot(nullptr), large_iter(iter)
+    {
+    }
+
+    common_iterator(const common_iterator<false> &other) : ctrl(other.ctrl), slot(other.slot), large_iter(other.large_iter)
+    {
+    }
+
+    common_iterator &operator=(const common_iterator &other) = default;
+
+    reference operator*() const
+    {
+        return (ctrl != nullptr ? *slot : *large_iter);
+    }
+
+    pointer operator->() const
+    {
+        return &**this;
+    }
+
+    common_iterator &operator++()
+    {
+        if (ctrl == nullptr)
+        {
+            ++large_iter;
+            return *this;
+        }
+
+        ++ctrl;
+        ++slot;
+        skip_free();
+        return *this;
+    }
+
+    common_iterator operator++(int)
+    {
+        auto copy = *this;
+        ++(*this);
+        return copy;
+    }
+
+    bool operator==(const common_iterator &other) const
+    {
+        return ctrl == other.ctrl && (ctrl != nullptr || large_iter == other.large_iter);
+    }
+
+    bool operator!=(const common_iterator &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// stored functors
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+const Hash &UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::hasher() const
+{
+    return HashHolder::get();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+const Equal &UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::equality() const
+{
+    return EqualHolder::get();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::SlotAlloc &UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::slot_alloc()
+{
+    return AllocHolder::get();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+const typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::SlotAlloc &UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::slot_alloc() const
+{
+    return AllocHolder::get();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+Hash UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::hash_function() const
+{
+    return hasher();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+Equal UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::key_eq() const
+{
+    return equality();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+Alloc UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::get_allocator() const
+{
+    return Alloc(AllocHolder::get());
+}
+
+// inline slots
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::NodeType *UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::slots()
+{
+    return reinterpret_cast<NodeType *>(inline_slots);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+const typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::NodeType *UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::slots() const
+{
+    return reinterpret_cast<const NodeType *>(inline_slots);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+int8_t UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::h2_of(size_t hash)
+{
+    // std::hash is the identity for integers, the top bits of one multiply are spread well enough
+    return static_cast<int8_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> 57);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename U>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::find_inline(const U &key, int8_t h2) const
+{
+    if (curr_size == 0)
+    {
+        UNORDERED_MAP_COUNT(counters.record_lookup(0);)
+        return InlineCount;
+    }
+
+    FlatGroup group(ctrl);
+    for (uint32_t mask = group.match(h2); mask != 0; mask &= mask - 1)
+    {
+        size_t ind = FlatGroup::lowest(mask);
+        if (equality()(slots()[ind].first, key))
+        {
+            UNORDERED_MAP_COUNT(counters.record_lookup(1);)
+            return ind;
+        }
+    }
+
+    UNORDERED_MAP_COUNT(counters.record_lookup(1);)
+    return InlineCount;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::clear_inline()
+{
+    for (size_t i = 0; i < InlineCount; i++)
+    {
+        if (ctrl[i] >= 0)
+        {
+            SlotTraits::destroy(slot_alloc(), slots() + i);
+            ctrl[i] = flat_empty;
+        }
+    }
+    curr_size = 0;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::take_elements(UnorderedMap &other)
+{
+    // *this holds nothing yet, other is left empty
+    max_lf = other.max_lf;
+
+    if (other.large)
+    {
+        large.emplace(std::move(*other.large));
+        other.large.reset();
+        return;
+    }
+
+    for (size_t i = 0; i < InlineCount; i++)
+    {
+        if (other.ctrl[i] >= 0)
+        {
+            SlotTraits::construct(slot_alloc(), slots() + i, std::move(other.slots()[i]));
+            ctrl[i] = other.ctrl[i];
+        }
+    }
+    curr_size = other.curr_size;
+    other.clear_inline();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::spill(size_t needed_cap)
+{
+    UNORDERED_MAP_COUNT(auto rehash_started = MapCounters::Clock::now();)
+
+    // the large map is sized before the first element is moved into it
+    LargeMap fresh(LargeMap::init_cap, hasher(), equality(), get_allocator());
+    fresh.max_load_factor(max_lf);
+    fresh.reserve(needed_cap);
+
+    for (size_t i = 0; i < InlineCount; i++)
+    {
+        if (ctrl[i] >= 0)
+        {
+            fresh.try_emplace(std::move(slots()[i].first), std::move(slots()[i].second));
+        }
+    }
+
+    clear_inline();
+    large.emplace(std::move(fresh));
+
+    UNORDERED_MAP_COUNT(counters.record_rehash(rehash_started);)
+}
+
+// constructors
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::UnorderedMap() : UnorderedMap(init_cap)
+{
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::UnorderedMap(size_t bucket_count, const Hash &hash, const Equal &equal, const Alloc &alloc)
+    : HashHolder(hash), EqualHolder(equal), AllocHolder(SlotAlloc(alloc))
+{
+    std::memset(ctrl, static_cast<uint8_t>(flat_empty), InlineCount);
+    std::memset(ctrl + InlineCount, static_cast<uint8_t>(flat_sentinel), FlatGroup::width - InlineCount);
+
+    if (bucket_count > InlineCount)
+    {
+        large.emplace(bucket_count, hash, equal, alloc);
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::UnorderedMap(const Alloc &alloc) : UnorderedMap(init_cap, Hash(), Equal(), alloc)
+{
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename InputIt, typename>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::UnorderedMap(InputIt first, InputIt last, size_t bucket_count, const Hash &hash,
+                                                                                                   const Equal &equal, const Alloc &alloc)
+    : UnorderedMap(bucket_count, hash, equal, alloc)
+{
+    insert_range(first, last);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::UnorderedMap(const UnorderedMap &other)
+    : HashHolder(other.hasher()), EqualHolder(other.equality()),
+      AllocHolder(SlotTraits::select_on_container_copy_construction(other.slot_alloc())), max_lf(other.max_lf)
+{
+    std::memcpy(ctrl, other.ctrl, FlatGroup::width);
+
+    if (other.large)
+    {
+        large.emplace(*other.large);
+        return;
+    }
+
+    // same hash, so the slots are copied in place
+    size_t i = 0;
+    try
+    {
+        for (; i < InlineCount; i++)
+        {
+            if (other.ctrl[i] >= 0)
+            {
+                SlotTraits::construct(slot_alloc(), slots() + i, other.slots()[i]);
+            }
+        }
+    }
+    catch (...)
+    {
+        std::memset(ctrl + i, static_cast<uint8_t>(flat_empty), InlineCount - i);
+        clear_inline();
+        throw;
+    }
+    curr_size = other.curr_size;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::UnorderedMap(UnorderedMap &&other)
+    : HashHolder(other.hasher()), EqualHolder(other.equality()), AllocHolder(other.slot_alloc())
+{
+    std::memset(ctrl, static_cast<uint8_t>(flat_empty), InlineCount);
+    std::memset(ctrl + InlineCount, static_cast<uint8_t>(flat_sentinel), FlatGroup::width - InlineCount);
+
+    take_elements(other);
+    other.max_lf = init_load_factor;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::~UnorderedMap()
+{
+    clear_inline();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>> &UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::operator=(const UnorderedMap &other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    UnorderedMap copy(other);
+
+    swap(copy);
+
+    return *this;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>> &UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::operator=(UnorderedMap &&other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    UnorderedMap copy(std::move(other));
+
+    swap(copy);
+
+    return *this;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::swap(UnorderedMap &other)
+{
+    if (this == &other)
+    {
+        return;
+    }
+
+    // inline elements cannot trade places by pointer, they are moved through a third map
+    UnorderedMap tmp(std::move(other));
+    other.take_elements(*this);
+    take_elements(tmp);
+
+    std::swap(static_cast<HashHolder &>(*this), static_cast<HashHolder &>(other));
+    std::swap(static_cast<EqualHolder &>(*this), static_cast<EqualHolder &>(other));
+    std::swap(static_cast<AllocHolder &>(*this), static_cast<AllocHolder &>(other));
+}
+
+// self-info
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::size() const
+{
+    return (large ? large->size() : curr_size);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+bool UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::spilled() const
+{
+    return large.has_value();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::max_size() const
+{
+    return SlotTraits::max_size(slot_alloc());
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+double &UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::max_load_factor()
+{
+    return (large ? large->max_load_factor() : max_lf);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::max_load_factor(double new_load_factor)
+{
+    max_lf = new_load_factor;
+    if (large)
+    {
+        large->max_load_factor(new_load_factor);
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+double UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::load_factor() const
+{
+    if (large)
+    {
+        return large->load_factor();
+    }
+    return (static_cast<double>(curr_size) / static_cast<double>(InlineCount));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::reserve(size_t needed_cap)
+{
+    if (large)
+    {
+        large->reserve(needed_cap);
+    }
+    else if (needed_cap > InlineCount)
+    {
+        spill(needed_cap);
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::rehash()
+{
+    // inline slots have nothing to rehash
+    if (large)
+    {
+        large->rehash();
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+UnorderedMapStats UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::stats() const
+{
+    if (large)
+    {
+        return large->stats();
+    }
+
+    UnorderedMapStats result;
+    result.size = curr_size;
+    result.bucket_count = InlineCount;
+    result.load_factor = load_factor();
+    result.chain_lengths.assign(1, curr_size);
+    result.max_probe_length = (curr_size == 0 ? 0 : 1);
+
+    result.bucket_bytes = sizeof(ctrl);
+    result.node_bytes = curr_size * sizeof(NodeType);
+    // free inline slots and the rest of the map object, nothing lives outside of it
+    result.overhead_bytes = sizeof(*this) - result.bucket_bytes - result.node_bytes;
+
+    UNORDERED_MAP_COUNT(counters.fill(result);)
+    return result;
+}
+
+// iterator initialization
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::begin()
+{
+    if (large)
+    {
+        return Iterator(large->begin());
+    }
+
+    Iterator iter(ctrl, slots());
+    iter.skip_free();
+    return iter;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::begin() const
+{
+    return cbegin();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::end()
+{
+    if (large)
+    {
+        return Iterator(large->end());
+    }
+    return Iterator(ctrl + InlineCount, slots() + InlineCount);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::end() const
+{
+    return cend();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::cbegin() const
+{
+    if (large)
+    {
+        return ConstIterator(large->cbegin());
+    }
+
+    ConstIterator iter(ctrl, slots());
+    iter.skip_free();
+    return iter;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::cend() const
+{
+    if (large)
+    {
+        return ConstIterator(large->cend());
+    }
+    return ConstIterator(ctrl + InlineCount, slots() + InlineCount);
+}
+
+// lookup
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename U>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::Iterator UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::find(U &&key)
+{
+    if (large)
+    {
+        return Iterator(large->find(std::forward<U>(key)));
+    }
+
+    const auto &lookup = lookup_key<Key, transparent>(key);
+    size_t ind = find_inline(lookup, h2_of(hasher()(lookup)));
+    return Iterator(ctrl + ind, slots() + ind);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename U>
+typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::ConstIterator UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::find(U &&key) const
+{
+    if (large)
+    {
+        const LargeMap &large_map = *large;
+        return ConstIterator(large_map.find(std::forward<U>(key)));
+    }
+
+    const auto &lookup = lookup_key<Key, transparent>(key);
+    size_t ind = find_inline(lookup, h2_of(hasher()(lookup)));
+    return ConstIterator(ctrl + ind, slots() + ind);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename KeyIt, typename OutIt>
+OutIt UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::find_batch(KeyIt first, KeyIt last, OutIt out)
+{
+    if (large)
+    {
+        return large->find_batch(first, last, WrapOutput<OutIt, Iterator>{out}).out;
+    }
+
+    // the inline slots share one cache line or two, there is nothing to prefetch
+    for (; first != last; ++first)
+    {
+        *out = find(*first);
+        ++out;
+    }
+    return out;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename KeyIt, typename OutIt>
+OutIt UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::find_batch(KeyIt first, KeyIt last, OutIt out) const
+{
+    if (large)
+    {
+        const LargeMap &large_map = *large;
+        return large_map.find_batch(first, last, WrapOutput<OutIt, ConstIterator>{out}).out;
+    }
+
+    for (; first != last; ++first)
+    {
+        *out = find(*first);
+        ++out;
+    }
+    return out;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename InputIt>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::insert_batch(InputIt first, InputIt last)
+{
+    size_t inserted = 0;
+    for (; first != last && !large; ++first)
+    {
+        inserted += emplace_hashed((*first).first, hash_of((*first).first), *first).second;
+    }
+
+    // whatever is left after the switch goes through the batched path of the large map
+    if (large)
+    {
+        inserted += large->insert_batch(first, last);
+    }
+    return inserted;
+}
+
+// element insertion/deletion
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename U>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::hash_of(const U &key) const
+{
+    return (large ? large->hash_of(key) : hasher()(key));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename K, typename... Args>
+std::pair<typename UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::Iterator, bool> UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::emplace_hashed(const K &key, size_t hash, Args &&...node_args)
+{
+    if (!large)
+    {
+        int8_t h2 = h2_of(hash);
+        size_t ind = find_inline(key, h2);
+        if (ind != InlineCount)
+        {
+            return std::make_pair(Iterator(ctrl + ind, slots() + ind), false);
+        }
+
+        if (curr_size != InlineCount)
+        {
+            ind = FlatGroup::lowest(FlatGroup(ctrl).match_empty());
+            UNORDERED_MAP_COUNT(counters.record_insert(false);)
+
+            // the value is built before the slot is marked full, so a throwing constructor leaves the map intact
+            SlotTraits::construct(slot_alloc(), slots() + ind, std::forward<Args>(node_args)...);
+
+            ctrl[ind] = h2;
+            ++curr_size;
+
+            return std::make_pair(Iterator(ctrl + ind, slots() + ind), true);
+        }
+
+        // the large map may hash differently, so the key is hashed again for it
+        spill(InlineCount + 1);
+        hash = large->hash_of(key);
+    }
+
+    auto result = large->emplace_hashed(key, hash, std::forward<Args>(node_args)...);
+    return std::make_pair(Iterator(result.first), result.second);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+template <typename InputIt>
+size_t UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::insert_range(InputIt first, InputIt last, bool sort_by_bucket)
+{
+    using Category = typename std::iterator_traits<InputIt>::iterator_category;
+
+    // a forward range that cannot fit inline switches once up front
+    if constexpr (std::is_convertible<Category, std::forward_iterator_tag>::value)
+    {
+        if (!large && curr_size + static_cast<size_t>(std::distance(first, last)) > InlineCount)
+        {
+            spill(curr_size + static_cast<size_t>(std::distance(first, last)));
+        }
+    }
+
+    size_t inserted = 0;
+    for (; first != last && !large; ++first)
+    {
+        auto &&ins_pair = *first;
+        inserted += emplace_hashed(ins_pair.first, hash_of(ins_pair.first), std::forward<decltype(ins_pair)>(ins_pair)).second;
+    }
+
+    if (large)
+    {
+        inserted += large->insert_range(first, last, sort_by_bucket);
+    }
+    return inserted;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::erase(ConstIterator to_erase)
+{
+    if (to_erase.ctrl == nullptr)
+    {
+        large->erase(to_erase.large_iter);
+        return;
+    }
+
+    // the other slots stay where they are, so iterators and references to them remain valid
+    size_t ind = static_cast<size_t>(to_erase.ctrl - ctrl);
+    SlotTraits::destroy(slot_alloc(), slots() + ind);
+    ctrl[ind] = flat_empty;
+    --curr_size;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, size_t InlineCount, typename LargeStorage>
+void UnorderedMap<Key, Value, Hash, Equal, Alloc, SmallStorage<InlineCount, LargeStorage>>::erase(ConstIterator first, ConstIterator second)
+{
+    if (first.ctrl == nullptr)
+    {
+        large->erase(first.large_iter, second.large_iter);
+        return;
+    }
+
+    while (first != second)
+    {
+        ConstIterator copy = first;
+        ++first;
+        erase(copy);
+    }
+}
@@ -0,0 +1,452 @@
+#ifndef UNORDERED_MAP_SNAPSHOT_CPP
+#define UNORDERED_MAP_SNAPSHOT_CPP
+
+#include "unordered_map.cpp"
+
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define UNORDERED_MAP_SNAPSHOT_MMAP 1
+#endif
+
+// Read-only snapshot image of a map with trivially copyable keys and values.
+//
+// The image holds no pointers, so it can be mapped at any address and queried in place:
+//
+//     header | bucket_starts[bucket_count + 1] | hashes[size] | entries[size]
+//
+// Entries are grouped by bucket, bucket b owns entries [bucket_starts[b], bucket_starts[b + 1]).
+// hashes[i] is the full hash of entries[i] and rejects most mismatches before Equal runs.
+// Buckets are mix_hash_bits(hash) & (bucket_count - 1), so Hash has to give the same values
+// in the writing and the reading process. Integers are stored in native byte order.
+
+// one element of the image, laid out like the value_type of the map it came from
+template <typename Key, typename Value>
+struct SnapshotEntry
+{
+    Key first;
+    Value second;
+};
+
+struct SnapshotHeader
+{
+    static constexpr uint64_t magic_value = 0x31504E534D414D55ull; // "UMAMSNP1"
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint32_t byte_order_mark = 0x01020304;
+
+    uint64_t magic;
+    uint32_t version, byte_order;
+    uint32_t key_size, value_size, entry_size, entry_align;
+    uint64_t bucket_count, size;
+    uint64_t buckets_offset, hashes_offset, entries_offset, total_size;
+};
+
+inline uint64_t snapshot_align(uint64_t offset, uint64_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// builds the image of map in memory, the result can be written anywhere and mapped back
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+std::string build_snapshot(const UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage> &map)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "snapshot images only hold trivially copyable keys and values");
+
+    using Entry = SnapshotEntry<Key, Value>;
+
+    uint64_t size = map.size(), bucket_count = 1;
+    while (bucket_count < size)
+    {
+        bucket_count <<= 1;
+    }
+
+    SnapshotHeader header{};
+    header.magic = SnapshotHeader::magic_value;
+    header.version = SnapshotHeader::current_version;
+    header.byte_order = SnapshotHeader::byte_order_mark;
+    header.key_size = sizeof(Key);
+    header.value_size = sizeof(Value);
+    header.entry_size = sizeof(Entry);
+    header.entry_align = alignof(Entry);
+    header.bucket_count = bucket_count;
+    header.size = size;
+    header.buckets_offset = snapshot_align(sizeof(SnapshotHeader), 64);
+    header.hashes_offset = header.buckets_offset + (bucket_count + 1) * sizeof(uint64_t);
+    header.entries_offset = snapshot_align(header.hashes_offset + size * sizeof(uint64_t), std::max<uint64_t>(64, alignof(Entry)));
+    header.total_size = header.entries_offset + size * sizeof(Entry);
+
+    std::string image(header.total_size, '\0');
+    std::memcpy(&image[0], &header, sizeof(header));
+
+    // counting sort by bucket: count, prefix sums, then place
+    std::vector<uint64_t> hashes;
+    hashes.reserve(size);
+    std::vector<uint64_t> starts(bucket_count + 1, 0);
+    Hash hasher = map.hash_function();
+    for (const auto &elem : map)
+    {
+        hashes.push_back(static_cast<uint64_t>(hasher(elem.first)));
+        ++starts[(mix_hash_bits(hashes.back()) & (bucket_count - 1)) + 1];
+    }
+    for (uint64_t bucket = 0; bucket < bucket_count; bucket++)
+    {
+        starts[bucket + 1] += starts[bucket];
+    }
+    std::memcpy(&image[header.buckets_offset], starts.data(), starts.size() * sizeof(uint64_t));
+
+    size_t elem_ind = 0;
+    for (const auto &elem : map)
+    {
+        uint64_t hash = hashes[elem_ind++];
+        uint64_t pos = starts[mix_hash_bits(hash) & (bucket_count - 1)]++;
+
+        // fields are copied one by one into the zeroed image, so padding bytes stay zero
+        Entry *slot = reinterpret_cast<Entry *>(&image[header.entries_offset + pos * sizeof(Entry)]);
+        std::memcpy(&slot->first, &elem.first, sizeof(Key));
+        std::memcpy(&slot->second, &elem.second, sizeof(Value));
+
+        std::memcpy(&image[header.hashes_offset + pos * sizeof(uint64_t)], &hash, sizeof(hash));
+    }
+
+    return image;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void save_snapshot(const UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage> &map, const std::string &path)
+{
+    std::string image = build_snapshot(map);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(image.data(), static_cast<std::streamsize>(image.size()));
+    if (!out)
+    {
+        throw std::runtime_error("Cannot write snapshot " + path);
+    }
+}
+
+// read-only map over a snapshot image: find/at/count/contains/begin/end run directly on the
+// mapped bytes, opening costs one mmap and a header check whatever the size
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>>
+class MappedUnorderedMap
+{
+public:
+    using NodeType = SnapshotEntry<Key, Value>;
+    using ConstIterator = const NodeType *;
+
+    static constexpr bool transparent = IsTransparent<Hash>::value && IsTransparent<Equal>::value;
+
+private:
+    const char *image = nullptr;
+    size_t image_size = 0;
+    bool owns_mapping = false;
+
+    const SnapshotHeader *header = nullptr;
+    const uint64_t *bucket_starts = nullptr;
+    const uint64_t *hashes = nullptr;
+    const NodeType *entries = nullptr;
+
+    Hash hash_fn;
+    Equal equal_fn;
+
+    void attach(const char *data, size_t length);
+    void release();
+
+public:
+    // bytes of an image already in memory, e.g. build_snapshot output, they have to outlive the map
+    MappedUnorderedMap(const void *data, size_t length, const Hash &hash = Hash(), const Equal &equal = Equal());
+
+    // maps the file read-only and shared, so every process of the host uses one page cache copy
+    explicit MappedUnorderedMap(const std::string &path, const Hash &hash = Hash(), const Equal &equal = Equal());
+
+    MappedUnorderedMap(const MappedUnorderedMap &other) = delete;
+    MappedUnorderedMap &operator=(const MappedUnorderedMap &other) = delete;
+
+    MappedUnorderedMap(MappedUnorderedMap &&other);
+    MappedUnorderedMap &operator=(MappedUnorderedMap &&other);
+
+    ~MappedUnorderedMap();
+
+    ConstIterator begin() const;
+    ConstIterator end() const;
+
+    size_t size() const;
+    size_t bucket_count() const;
+
+    template <typename U>
+    ConstIterator find(const U &key) const;
+
+    template <typename U>
+    size_t count(const U &key) const;
+
+    template <typename U>
+    bool contains(const U &key) const;
+
+    template <typename U>
+    const Value &at(const U &key) const;
+};
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+void MappedUnorderedMap<Key, Value, Hash, Equal>::attach(const char *data, size_t length)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "snapshot images only hold trivially copyable keys and values");
+
+    if (length < sizeof(SnapshotHeader) || reinterpret_cast<uintptr_t>(data) % alignof(SnapshotHeader) != 0 ||
+        reinterpret_cast<uintptr_t>(data) % alignof(NodeType) != 0)
+    {
+        throw std::runtime_error("Snapshot image is truncated or misaligned");
+    }
+
+    const SnapshotHeader *head = reinterpret_cast<const SnapshotHeader *>(data);
+    if (head->magic != SnapshotHeader::magic_value || head->version != SnapshotHeader::current_version ||
+        head->byte_order != SnapshotHeader::byte_order_mark)
+    {
+        throw std::runtime_error("Not a snapshot image of this version and byte order");
+    }
+
+    if (head->key_size != sizeof(Key) || head->value_size != sizeof(Value) || head->entry_size != sizeof(NodeType) ||
+        head->entry_align != alignof(NodeType))
+    {
+        throw std::runtime_error("Snapshot image was written for other key/value types");
+    }
+
+    // sections are checked as counts that fit between the offsets, so a corrupt header cannot wrap around
+    uint64_t buckets = head->bucket_count;
+    if (buckets == 0 || (buckets & (buckets - 1)) != 0 || head->total_size > length ||
+        head->buckets_offset > head->hashes_offset || head->hashes_offset > head->entries_offset ||
+        head->entries_offset > head->total_size ||
+        buckets >= (head->hashes_offset - head->buckets_offset) / sizeof(uint64_t) ||
+        head->size > (head->entries_offset - head->hashes_offset) / sizeof(uint64_t) ||
+        head->size > (head->total_size - head->entries_offset) / sizeof(NodeType) ||
+        head->buckets_offset % alignof(uint64_t) != 0 || head->hashes_offset % alignof(uint64_t) != 0 ||
+        head->entries_offset % alignof(NodeType) != 0)
+    {
+        throw std::runtime_error("Snapshot image layout is corrupt");
+    }
+
+    image = data;
+    image_size = length;
+    header = head;
+    bucket_starts = reinterpret_cast<const uint64_t *>(data + head->buckets_offset);
+    hashes = reinterpret_cast<const uint64_t *>(data + head->hashes_offset);
+    entries = reinterpret_cast<const NodeType *>(data + head->entries_offset);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+void MappedUnorderedMap<Key, Value, Hash, Equal>::release()
+{
+#if defined(UNORDERED_MAP_SNAPSHOT_MMAP)
+    if (owns_mapping)
+    {
+        munmap(const_cast<char *>(image), image_size);
+    }
+#else
+    if (owns_mapping)
+    {
+        ::operator delete(const_cast<char *>(image), std::align_val_t(64));
+    }
+#endif
+    image = nullptr;
+    image_size = 0;
+    owns_mapping = false;
+}
+
+// constructors
+template <typename Key, typename Value, typename Hash, typename Equal>
+MappedUnorderedMap<Key, Value, Hash, Equal>::MappedUnorderedMap(const void *data, size_t length, const Hash &hash, const Equal &equal)
+    : hash_fn(hash), equal_fn(equal)
+{
+    attach(static_cast<const char *>(data), length);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+MappedUnorderedMap<Key, Value, Hash, Equal>::MappedUnorderedMap(const std::string &path, const Hash &hash, const Equal &equal)
+    : hash_fn(hash), equal_fn(equal)
+{
+#if defined(UNORDERED_MAP_SNAPSHOT_MMAP)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open snapshot " + path);
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0)
+    {
+        close(fd);
+        throw std::runtime_error("Cannot stat snapshot " + path);
+    }
+
+    size_t length = static_cast<size_t>(file_stat.st_size);
+    void *mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Cannot map snapshot " + path);
+    }
+
+    image = static_cast<const char *>(mapping);
+    image_size = length;
+    owns_mapping = true;
+#else
+    // without mmap the image is read in one piece, still nothing is deserialized
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        throw std::runtime_error("Cannot open snapshot " + path);
+    }
+
+    size_t length = static_cast<size_t>(in.tellg());
+    char *buffer = static_cast<char *>(::operator new(length, std::align_val_t(64)));
+    in.seekg(0);
+    in.read(buffer, static_cast<std::streamsize>(length));
+
+    image = buffer;
+    image_size = length;
+    owns_mapping = true;
+#endif
+
+    try
+    {
+        attach(image, image_size);
+    }
+    catch (...)
+    {
+        release();
+        throw;
+    }
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+MappedUnorderedMap<Key, Value, Hash, Equal>::MappedUnorderedMap(MappedUnorderedMap &&other)
+    : image(other.image), image_size(other.image_size), owns_mapping(other.owns_mapping), header(other.header),
+      bucket_starts(other.bucket_starts), hashes(other.hashes), entries(other.entries), hash_fn(other.hash_fn),
+      equal_fn(other.equal_fn)
+{
+    other.image = nullptr;
+    other.image_size = 0;
+    other.owns_mapping = false;
+    other.header = nullptr;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+MappedUnorderedMap<Key, Value, Hash, Equal> &MappedUnorderedMap<Key, Value, Hash, Equal>::operator=(MappedUnorderedMap &&other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    release();
+    image = other.image;
+    image_size = other.image_size;
+    owns_mapping = other.owns_mapping;
+    header = other.header;
+    bucket_starts = other.bucket_starts;
+    hashes = other.hashes;
+    entries = other.entries;
+    hash_fn = other.hash_fn;
+    equal_fn = other.equal_fn;
+
+    other.image = nullptr;
+    other.image_size = 0;
+    other.owns_mapping = false;
+    other.header = nullptr;
+
+    return *this;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+MappedUnorderedMap<Key, Value, Hash, Equal>::~MappedUnorderedMap()
+{
+    release();
+}
+
+// lookup
+template <typename Key, typename Value, typename Hash, typename Equal>
+typename MappedUnorderedMap<Key, Value, Hash, Equal>::ConstIterator MappedUnorderedMap<Key, Value, Hash, Equal>::begin() const
+{
+    return entries;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+typename MappedUnorderedMap<Key, Value, Hash, Equal>::ConstIterator MappedUnorderedMap<Key, Value, Hash, Equal>::end() const
+{
+    return (header == nullptr ? entries : entries + header->size);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+size_t MappedUnorderedMap<Key, Value, Hash, Equal>::size() const
+{
+    return (header == nullptr ? 0 : static_cast<size_t>(header->size));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+size_t MappedUnorderedMap<Key, Value, Hash, Equal>::bucket_count() const
+{
+    return (header == nullptr ? 0 : static_cast<size_t>(header->bucket_count));
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+template <typename U>
+typename MappedUnorderedMap<Key, Value, Hash, Equal>::ConstIterator MappedUnorderedMap<Key, Value, Hash, Equal>::find(const U &key) const
+{
+    if (header == nullptr)
+    {
+        return end();
+    }
+
+    const auto &lookup = lookup_key<Key, transparent>(key);
+    uint64_t hash = static_cast<uint64_t>(hash_fn(lookup));
+    uint64_t bucket = mix_hash_bits(hash) & (header->bucket_count - 1);
+
+    // bucket_starts is not checked on attach, a corrupt run still stays inside the entries
+    uint64_t run_end = std::min(bucket_starts[bucket + 1], header->size);
+    for (uint64_t pos = bucket_starts[bucket]; pos < run_end; pos++)
+    {
+        if (hashes[pos] == hash && equal_fn(entries[pos].first, lookup))
+        {
+            return entries + pos;
+        }
+    }
+    return end();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+template <typename U>
+size_t MappedUnorderedMap<Key, Value, Hash, Equal>::count(const U &key) const
+{
+    return (find(key) != end() ? 1 : 0);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+template <typename U>
+bool MappedUnorderedMap<Key, Value, Hash, Equal>::contains(const U &key) const
+{
+    return find(key) != end();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal>
+template <typename U>
+const Value &MappedUnorderedMap<Key, Value, Hash, Equal>::at(const U &key) const
+{
+    auto elem_pos = find(key);
+
+    if (elem_pos != end())
+    {
+        return elem_pos->second;
+    }
+
+    throw std::out_of_range("No such key exists!");
+}
+
+#endif // UNORDERED_MAP_SNAPSHOT_CPP
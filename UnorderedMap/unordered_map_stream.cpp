@@ -0,0 +1,167 @@
+#ifndef UNORDERED_MAP_STREAM_CPP
+#define UNORDERED_MAP_STREAM_CPP
+
+#include "unordered_map.cpp"
+#include "stream_framing.cpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Streaming dump of a map with trivially copyable keys and values, meant for checkpoints
+// written to files or pipes. Unlike a snapshot image it is produced front to back in
+// bounded chunks framed as in stream_framing.cpp, neither side ever holds the whole dump in memory.
+// A data chunk payload is records * (key bytes, value bytes). Torn, truncated or spliced
+// streams fail a checksum and are rejected.
+
+struct MapStreamHeader
+{
+    static constexpr uint64_t magic_value = 0x315254534D414D55ull; // "UMAMSTR1"
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint32_t byte_order_mark = 0x01020304;
+
+    uint64_t magic;
+    uint32_t version, byte_order;
+    uint32_t key_size, value_size;
+    uint64_t size;
+};
+
+// writes map to out, records are gathered from the nodes straight into one chunk buffer
+// of at most chunk_bytes, so the stream sees a few large writes instead of one per element
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void write_stream(const UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage> &map, std::ostream &out,
+                  size_t chunk_bytes = StreamWriter::default_chunk_bytes)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "streams only hold trivially copyable keys and values");
+
+    constexpr size_t record_size = sizeof(Key) + sizeof(Value);
+    size_t per_chunk = std::max<size_t>(1, std::min(chunk_bytes, StreamWriter::max_chunk_bytes) / record_size);
+
+    MapStreamHeader header{};
+    header.magic = MapStreamHeader::magic_value;
+    header.version = MapStreamHeader::current_version;
+    header.byte_order = MapStreamHeader::byte_order_mark;
+    header.key_size = sizeof(Key);
+    header.value_size = sizeof(Value);
+    header.size = map.size();
+
+    StreamWriter writer(out);
+    writer.write_chunk(&header, sizeof(header), 1);
+
+    std::vector<char> buffer(std::min<size_t>(per_chunk, map.size()) * record_size);
+    size_t records = 0;
+    for (const auto &elem : map)
+    {
+        char *record = buffer.data() + records * record_size;
+        std::memcpy(record, &elem.first, sizeof(Key));
+        std::memcpy(record + sizeof(Key), &elem.second, sizeof(Value));
+
+        if (++records == per_chunk)
+        {
+            writer.write_chunk(buffer.data(), records * record_size, records);
+            records = 0;
+        }
+    }
+    if (records != 0)
+    {
+        writer.write_chunk(buffer.data(), records * record_size, records);
+    }
+
+    writer.finish();
+}
+
+// adds the elements of a stream to map, which is reserved for up to StreamReader::max_reserve_bytes
+// of records before the first insert, keys already in map keep their values. Throws
+// std::runtime_error on a foreign, truncated or corrupted stream, elements of the chunks verified
+// before that stay inserted.
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void read_stream(std::istream &in, UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage> &map)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "streams only hold trivially copyable keys and values");
+
+    constexpr size_t record_size = sizeof(Key) + sizeof(Value);
+
+    StreamReader reader(in);
+    MapStreamHeader header;
+    reader.read_chunk(&header, sizeof(header));
+
+    if (header.magic != MapStreamHeader::magic_value || header.version != MapStreamHeader::current_version ||
+        header.byte_order != MapStreamHeader::byte_order_mark)
+    {
+        throw std::runtime_error("Not a map stream of this version and byte order");
+    }
+    if (header.key_size != sizeof(Key) || header.value_size != sizeof(Value))
+    {
+        throw std::runtime_error("Stream was written for other key or value types");
+    }
+
+    if (header.size > map.max_size() - map.size())
+    {
+        throw std::runtime_error("Stream does not fit the map");
+    }
+    map.reserve(map.size() + std::min<uint64_t>(header.size, StreamReader::max_reserve_bytes / record_size));
+
+    std::vector<char> buffer;
+    uint64_t loaded = 0;
+    while (loaded < header.size)
+    {
+        size_t records = reader.begin_chunk(record_size);
+        if (records == 0 || records > header.size - loaded)
+        {
+            throw std::runtime_error("Stream chunk is corrupted");
+        }
+
+        buffer.resize(records * record_size);
+        reader.read(buffer.data(), buffer.size());
+        reader.end_chunk();
+
+        for (size_t i = 0; i < records; i++)
+        {
+            // the record is copied out as raw bytes, Key and Value need no default constructor
+            alignas(Key) unsigned char key[sizeof(Key)];
+            alignas(Value) unsigned char value[sizeof(Value)];
+            std::memcpy(key, buffer.data() + i * record_size, sizeof(Key));
+            std::memcpy(value, buffer.data() + i * record_size + sizeof(Key), sizeof(Value));
+            map.try_emplace(*reinterpret_cast<const Key *>(key), *reinterpret_cast<const Value *>(value));
+        }
+        loaded += records;
+    }
+
+    if (reader.begin_chunk(record_size) != 0)
+    {
+        throw std::runtime_error("Stream chunk is corrupted");
+    }
+    reader.finish();
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void save_stream(const UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage> &map, const std::string &path,
+                 size_t chunk_bytes = StreamWriter::default_chunk_bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        throw std::runtime_error("Cannot open stream " + path);
+    }
+    write_stream(map, out, chunk_bytes);
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc, typename Storage>
+void load_stream(const std::string &path, UnorderedMap<Key, Value, Hash, Equal, Alloc, Storage> &map)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Cannot open stream " + path);
+    }
+    read_stream(in, map);
+}
+
+#endif // UNORDERED_MAP_STREAM_CPP